@@ -9,18 +9,96 @@
 
 #include "ubertooth.h"
 
-// advertising channel 38
-uint16_t rf_channel = 2426;
+#include <string.h>
 
-// initialize RF and strobe FSON
-static void cc2400_init_rf(void) {
+// advertising channels in MHz, in the order they are scanned
+static const uint16_t ble_channels[BLE_ADV_CHANNELS] = { 2402, 2426, 2480 };
+
+// dewhitening for each of ble_channels, generated by whitening_gen.py
+extern const uint32_t ble_whitening[BLE_ADV_CHANNELS][BLE_PACKET_SIZE / 4];
+
+// start on channel 38, so a dwell of 0 receives where the radio always has
+static volatile unsigned channel = 1;
+static uint32_t dwell_start = 0; // ble_now_us() at tuning in to channel
+static int hopping = 1;          // retuning, dwell_start not yet set
+
+uint32_t ble_dwell_ms = BLE_DWELL_MS;
+
+ble_channel_stats_t ble_stats[BLE_ADV_CHANNELS];
+
+// CC2400 GIO signal that is high from sync word detection until the end of
+// the packet, GIO6 interrupts on its falling edge
+#ifndef GIO_PKT
+#define GIO_PKT 0x0f
+#endif
+#define GIO6_CFG_SHIFT 9
+
+// packets received by the GIO6 interrupt and not yet taken by the main loop
+#define BLE_RING_LEN 4 // power of 2
+
+typedef struct _ble_rx_t {
+    ble_rx_info_t info;
+    uint8_t data[BLE_PACKET_SIZE];
+} ble_rx_t;
+
+static ble_rx_t ble_ring[BLE_RING_LEN];
+static volatile unsigned ring_head = 0; // written by the interrupt
+static volatile unsigned ring_tail = 0; // written by ble_get_packet
+
+volatile uint32_t ble_rx_overruns = 0;
+volatile uint32_t ble_rx_bad_header = 0;
+volatile uint32_t ble_rx_bad_crc = 0;
+
+// advertising PDU header, Core spec Vol 6 Part B 2.3
+#define PDU_TYPE(pkt)   ((pkt)[0] & 0x0f)
+#define PDU_LEN(pkt)    ((pkt)[1])
+#define PDU_HEADER_LEN  2
+#define ADV_ADDR_LEN    6
+#define ADV_MAX_LEN     37
+
+// PDU types that carry AD structures a trigger can be in: ADV_IND,
+// ADV_NONCONN_IND, SCAN_RSP and ADV_SCAN_IND
+#define ADV_DATA_TYPES  ((1 << 0x0) | (1 << 0x2) | (1 << 0x4) | (1 << 0x6))
+
+// CRC-24, x^24 + x^10 + x^9 + x^6 + x^4 + x^3 + x + 1 preset with 0x555555
+// on advertising channels (Core spec Vol 6 Part B 3.1.1). Bits are taken in
+// the order they were on air, bit 0 of each byte first, so it is computed
+// reflected and lands in the packet little endian.
+#define CRC_LEN         3
+#define CRC_INIT        0xaaaaaa // 0x555555 reflected
+
+// CRC of each nibble, for taking 4 bits a step
+static const uint32_t crc_nibble[16] = {
+    0x000000, 0x1b4c00, 0x369800, 0x2dd400, 0x6d3000, 0x767c00, 0x5ba800, 0x40e400,
+    0xda6000, 0xc12c00, 0xecf800, 0xf7b400, 0xb75000, 0xac1c00, 0x81c800, 0x9a8400,
+};
+
+// radio state, advanced by ble_poll and the packet interrupt without
+// waiting on the radio
+#define RADIO_START         0   // turn the radio off to reconfigure it
+#define RADIO_WAIT_UNLOCK   1   // SRFOFF strobed, waiting for FS_LOCK to drop
+#define RADIO_WAIT_XOSC     2   // configured, waiting for XOSC16M_STABLE
+#define RADIO_WAIT_LOCK     3   // SFSON strobed, waiting for FS_LOCK
+#define RADIO_WAIT_RX       4   // SRX strobed, waiting for the RX state
+#define RADIO_RX            5   // receiving
+
+// how long the radio may take to reach each state before it is restarted
+#define RADIO_TIMEOUT_US    1000
+
+static volatile int radio_state = RADIO_START;
+static volatile uint32_t radio_deadline = 0;
+
+volatile uint32_t ble_radio_timeouts = 0;
+
+// configure RF, including the packet interrupt on GIO6
+static void cc2400_config_rf(void) {
     u16 grmdm, mdmctrl;
     uint32_t sync = rbit(0x8e89bed6);
 
     mdmctrl = 0x0040; // 250 kHz frequency deviation
     grmdm = 0x4CE1; // un-buffered mode, packet w/ sync word detection
     // 0 10 01 1 001 11 0 00 0 1
-    //   |  |  | |   |  +--------> CRC off
+    //   |  |  | |   |  +--------> CRC off (BLE CRC-24 is checked by ble_valid)
     //   |  |  | |   +-----------> sync word: 32 MSB bits of SYNC_WORD
     //   |  |  | +---------------> 1 preamble byte of 01010101
     //   |  |  +-----------------> packet mode
@@ -48,26 +126,20 @@ static void cc2400_init_rf(void) {
     cc2400_set(SYNCL,   sync & 0xffff);
     cc2400_set(SYNCH,   (sync >> 16) & 0xffff);
 
-    cc2400_set(FSDIV,   rf_channel - 1); // 1 MHz IF
+    cc2400_set(FSDIV,   ble_channels[channel] - 1); // 1 MHz IF
     cc2400_set(MDMCTRL, mdmctrl);
 
-    // XOSC16M should always be stable, but leave this test anyway
-    while (!(cc2400_status() & XOSC16M_STABLE));
-
-    // wait for FS_LOCK
-    cc2400_strobe(SFSON);
-    while (!(cc2400_status() & FS_LOCK)) ;
+    // interrupt at the end of each packet, leaving GIO1 as it was
+    cc2400_set(IOCFG, (cc2400_get(IOCFG) & 0x01ff) | (GIO_PKT << GIO6_CFG_SHIFT));
+    IO2IntClr = PIN_GIO6;
+    IO2IntEnF |= PIN_GIO6;
 }
 
 // dewhiten and reverse the bit order of a packet in place
 static void ble_dewhiten(uint8_t *pkt, unsigned len) {
     unsigned i;
     uint32_t *pkt_out = (void *)pkt;
-
-    uint32_t dewhiten[] = {
-        0x2044c5d6, 0x8fe1de59, 0x42afa51b, 0x60cd4e7b, 0x902262eb, 0xc7f0ef2c,
-        0xa157d28d, 0xb066a73d, 0x48113175, 0xe3f87796, 0xd0abe946, 0xd833539e,
-    };
+    const uint32_t *dewhiten = ble_whitening[channel];
 
     for (i = 0; i < len; i+= 4) {
         uint32_t v = pkt[i+0] << 24
@@ -78,32 +150,222 @@ static void ble_dewhiten(uint8_t *pkt, unsigned len) {
     }
 }
 
+static uint32_t ble_crc(const uint8_t *data, unsigned len) {
+    uint32_t crc = CRC_INIT;
+    unsigned i;
+
+    for (i = 0; i < len; ++i) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+    }
+
+    return crc;
+}
+
+// whether a dewhitened packet is an advertisement worth matching against,
+// checked cheapest first. Advertisements too long for their CRC to fit in
+// the FIFO are let through unchecked.
+static int ble_valid(const uint8_t *pkt) {
+    unsigned len = PDU_LEN(pkt), end;
+
+    if (!(ADV_DATA_TYPES & (1 << PDU_TYPE(pkt))) ||
+            len < ADV_ADDR_LEN || len > ADV_MAX_LEN) {
+        ++ble_rx_bad_header;
+        return 0;
+    }
+
+    end = PDU_HEADER_LEN + len;
+    if (end + CRC_LEN <= BLE_PACKET_SIZE &&
+            ble_crc(pkt, end) != (uint32_t)(pkt[end] | pkt[end+1] << 8 | pkt[end+2] << 16)) {
+        ++ble_rx_bad_crc;
+        return 0;
+    }
+
+    return 1;
+}
+
+// microseconds since timer0 started, timer0 counts ms and its prescaler
+// counts the 50 MHz peripheral clock within each ms
+uint32_t ble_now_us(void) {
+    uint32_t tc, pc;
+
+    do {
+        tc = T0TC;
+        pc = T0PC;
+    } while (tc != T0TC);
+
+    return tc * 1000 + pc / 50;
+}
+
+static void radio_wait(int state) {
+    radio_state = state;
+    radio_deadline = ble_now_us() + RADIO_TIMEOUT_US;
+}
+
+// strobe RX now if the synthesizer is locked, otherwise once it locks
+static void radio_rx(void) {
+    if (cc2400_status() & FS_LOCK) {
+        cc2400_strobe(SRX);
+        radio_wait(RADIO_WAIT_RX);
+    } else {
+        radio_wait(RADIO_WAIT_LOCK);
+    }
+}
+
+// bring the radio up, ble_poll finishes the job
 void ble_init(void) {
-    cc2400_strobe(SRFOFF);
-    while (cc2400_status() & FS_LOCK) ;
+    radio_state = RADIO_START;
+    ble_poll();
+}
 
-    cc2400_init_rf();
-    cc2400_strobe(SRX);
+// whether it is time to move on to the next channel
+static int dwell_over(void) {
+    return ble_dwell_ms != 0 && !hopping &&
+        ble_now_us() - dwell_start >= ble_dwell_ms * 1000;
 }
 
-int ble_get_packet(uint8_t *pkt) {
+// advance the radio towards receiving, returns 1 once it is receiving
+int ble_poll(void) {
+    if (radio_state == RADIO_RX && !dwell_over())
+        return 1;
+
+    // the packet interrupt also talks to the radio
+    ICER0 = ICER0_ICE_EINT3;
+
+    // move on to the next channel, but not away from a packet being
+    // received or drained
+    if ((radio_state == RADIO_RX || radio_state == RADIO_WAIT_RX) &&
+            dwell_over() && !((FIO2PIN | IO2IntStatF) & PIN_GIO6)) {
+        channel = (channel + 1) % BLE_ADV_CHANNELS;
+        hopping = 1;
+        radio_state = RADIO_START;
+    }
+
+    if (radio_state != RADIO_START && radio_state != RADIO_RX &&
+            (int32_t)(ble_now_us() - radio_deadline) >= 0) {
+        ++ble_radio_timeouts;
+        radio_state = RADIO_START;
+    }
+
+    switch (radio_state) {
+        case RADIO_START:
+            cc2400_strobe(SRFOFF);
+            radio_wait(RADIO_WAIT_UNLOCK);
+            break;
+
+        case RADIO_WAIT_UNLOCK:
+            if (!(cc2400_status() & FS_LOCK)) {
+                cc2400_config_rf();
+                radio_wait(RADIO_WAIT_XOSC);
+            }
+            break;
+
+        // XOSC16M should always be stable, but leave this test anyway
+        case RADIO_WAIT_XOSC:
+            if (cc2400_status() & XOSC16M_STABLE) {
+                cc2400_strobe(SFSON);
+                radio_wait(RADIO_WAIT_LOCK);
+            }
+            break;
+
+        case RADIO_WAIT_LOCK:
+            radio_rx();
+            break;
+
+        case RADIO_WAIT_RX:
+            if ((cc2400_get(FSMSTATE) & 0x1f) == STATE_STROBE_RX) {
+                radio_state = RADIO_RX;
+                if (hopping) {
+                    dwell_start = ble_now_us();
+                    hopping = 0;
+                }
+            }
+            break;
+    }
+
+    ISER0 = ISER0_ISE_EINT3;
+
+    return radio_state == RADIO_RX;
+}
+
+// stop receiving, e.g. before a reset
+void ble_off(void) {
+    ICER0 = ICER0_ICE_EINT3;
+    cc2400_strobe(SRFOFF);
+    radio_state = RADIO_START;
+}
+
+// drain a packet from the FIFO into the ring and restart RX
+static void ble_rx(void) {
+    ble_rx_t *rx = &ble_ring[ring_head % BLE_RING_LEN];
     unsigned i;
 
-    // when the FIFO is full the radio state returns to FS_ON
-    if ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON)
-        return 0;
+    // when the FIFO is full the radio state returns to FS_ON. If it is
+    // anywhere else while it should be receiving, RADIO_RX has no deadline
+    // to catch it, so start the radio over.
+    if ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON) {
+        if (radio_state == RADIO_RX || radio_state == RADIO_WAIT_RX) {
+            ++ble_radio_timeouts;
+            radio_state = RADIO_START;
+        }
+        return;
+    }
 
-    // load all bytes into buffer
-    for (i = 0; i < BLE_PACKET_SIZE; ++i)
-        pkt[i] = cc2400_get8(FIFOREG);
+    // the FIFO must be emptied to receive again, so if the main loop has
+    // fallen behind the packet is read and dropped
+    if (ring_head - ring_tail == BLE_RING_LEN) {
+        for (i = 0; i < BLE_PACKET_SIZE; ++i)
+            cc2400_get8(FIFOREG);
+        ++ble_rx_overruns;
+    } else {
+        for (i = 0; i < BLE_PACKET_SIZE; ++i)
+            rx->data[i] = cc2400_get8(FIFOREG);
+        ble_dewhiten(rx->data, BLE_PACKET_SIZE);
+        if (ble_valid(rx->data)) {
+            rx->info.time = ble_now_us();
+            rx->info.dwell = rx->info.time - dwell_start;
+            rx->info.channel = channel;
+            ++ring_head;
+            ++ble_stats[channel].packets;
+        }
+    }
 
-    // dewhiten
-    ble_dewhiten(pkt, BLE_PACKET_SIZE);
+    // restart RF, ble_poll sees it through
+    radio_rx();
+}
 
-    // restart RF
-    while (!(cc2400_status() & FS_LOCK)) ;
-    cc2400_strobe(SRX);
-    while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_RX) ;
+// EINT3 is shared by all GPIO interrupts, GIO6 is the only one enabled
+void EINT3_IRQHandler(void) {
+    if (IO2IntStatF & PIN_GIO6) {
+        IO2IntClr = PIN_GIO6;
+        ble_rx();
+    }
+}
+
+// take the oldest received packet, info (if not NULL) is set to when and
+// where it was received
+int ble_get_packet(uint8_t *pkt, ble_rx_info_t *info) {
+    ble_rx_t *rx;
+
+    if (ring_tail == ring_head)
+        return 0;
+
+    rx = &ble_ring[ring_tail % BLE_RING_LEN];
+    memcpy(pkt, rx->data, BLE_PACKET_SIZE);
+    if (info != NULL)
+        *info = rx->info;
+    ++ring_tail;
 
     return 1;
 }
+
+// record a packet that was a trigger in its channel's statistics
+void ble_count_trigger(const ble_rx_info_t *info) {
+    ble_channel_stats_t *stats = &ble_stats[info->channel];
+
+    ++stats->triggers;
+    stats->trigger_us += info->dwell;
+    if (info->dwell > stats->trigger_us_max)
+        stats->trigger_us_max = info->dwell;
+}
@@ -5,7 +5,47 @@
 
 #define BLE_PACKET_SIZE 32
 
+// channels 37, 38 and 39
+#define BLE_ADV_CHANNELS 3
+
+// default time spent on each advertising channel before moving to the next
+#ifndef BLE_DWELL_MS
+#define BLE_DWELL_MS 50
+#endif
+
+// where and when a packet was received
+typedef struct _ble_rx_info_t {
+    uint32_t time;      // ble_now_us() at the end of the packet
+    uint32_t dwell;     // us since the radio tuned in to the channel
+    unsigned channel;   // 0 to 2 for channels 37 to 39
+} ble_rx_info_t;
+
+// per channel receive and time to trigger statistics
+typedef struct _ble_channel_stats_t {
+    uint32_t packets;           // valid advertisements
+    uint32_t triggers;
+    uint32_t trigger_us;        // sum of the dwell time of each trigger
+    uint32_t trigger_us_max;    // longest dwell time of a trigger
+} ble_channel_stats_t;
+
+extern ble_channel_stats_t ble_stats[BLE_ADV_CHANNELS];
+
+// ms to spend on each channel, 0 stays on the current one (38 from boot)
+extern uint32_t ble_dwell_ms;
+
+// packets dropped because the main loop did not take them in time
+extern volatile uint32_t ble_rx_overruns;
+// packets dropped as not advertisements with AD data, or failing their CRC
+extern volatile uint32_t ble_rx_bad_header;
+extern volatile uint32_t ble_rx_bad_crc;
+// radio restarts because it did not reach a state in time
+extern volatile uint32_t ble_radio_timeouts;
+
 void ble_init(void);
-int ble_get_packet(uint8_t *pkt);
+int ble_poll(void);
+void ble_off(void);
+int ble_get_packet(uint8_t *pkt, ble_rx_info_t *info);
+void ble_count_trigger(const ble_rx_info_t *info);
+uint32_t ble_now_us(void);
 
 #endif /* __BLE_H__ */
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+// script bytecode, as run by uberducky.c and compiled by script_gen.py or
+// ducky.hpp
+//
+// a payload is its length in bytes (16 bit little endian) followed by ops
+//
+// encoding: <op> [<arg> .. ]
+//
+// NOP - no args
+// KEY - key type, modifier, character (each 1 byte), see hid.h
+// DELAY - delay in ms (16 bit little endian)
+// STRING - length (16 bit little endian), chars
+// REPEAT - count (16 bit little endian), runs the previous command again
+//          count times
+// LOOP - count (16 bit little endian), bytes to skip to get past the
+//        ENDLOOP when count is 0 (16 bit little endian)
+// ENDLOOP - no args, runs the body of the innermost LOOP again until it has
+//           run count times
+#define OP_NOP     0
+#define OP_KEY     1
+#define OP_DELAY   2
+#define OP_STRING  3
+#define OP_REPEAT  4
+#define OP_LOOP    5
+#define OP_ENDLOOP 6
+
+// deepest nesting of LOOPs, must match script_gen.py
+#define LOOP_DEPTH 4
+
+#endif /* __BYTECODE_H__ */
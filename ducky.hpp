@@ -0,0 +1,623 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Compile time duckyscript compiler, an alternative to script_gen.py for
+// builds that shouldn't need Python. A C++ file of payloads, such as
+// script.cpp, defines the script and script_index arrays payload.c reads:
+//
+//   #include "ducky.hpp"
+//
+//   DUCKY_SCRIPT(R"(
+//   STRING echo hello
+//   ENTER
+//   )");
+//
+// Each argument of DUCKY_SCRIPT is one payload, with its own TRIGGER when
+// there is more than one. The bytecode is built by constant evaluation and
+// lands in flash like any other constant, the opcodes come from bytecode.h
+// and the key types and modifiers from hid.h.
+//
+// The duckyscript is the same as script_gen.py takes, and the bytecode is
+// what script_gen.py --no-optimize emits for it. Characters are checked
+// against the layout header HID_LAYOUT_H names, the one layout.c is built
+// with. Like script_gen.py's, the layouts are in Latin-1, which the
+// Makefile compiles SCRIPT_CPP string literals to. It only emits bytecode,
+// not the report stream or compressed bytecode.
+//
+// With the layout and dewhitening tables kept in the tree, a SCRIPT_CPP
+// build runs no Python at all.
+//
+// A mistake in a script is a compile error. It stops constant evaluation by
+// reading one of the arrays in ducky::error past its end, so the compiler
+// names the error, and the subscript is the line of the script it is on,
+// counting the line the string starts on as 1:
+//
+//   error: array subscript value '4' is outside the bounds of array
+//   'ducky::error::unknown_command' of type 'const char [1]'
+
+#ifndef __DUCKY_HPP__
+#define __DUCKY_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+#include "bytecode.h"
+#include "hid.h"
+#include "payload.h"
+}
+
+#ifndef HID_LAYOUT_H
+#error "HID_LAYOUT_H must name a header in layouts/, the Makefile sets it from LAYOUT"
+#endif
+#include HID_LAYOUT_H
+
+namespace ducky {
+
+// largest argument that fits in a 16 bit opcode argument
+constexpr uint32_t MAX_ARG = 0xffff;
+
+// an array of bytes, laid out as the plain array payload.c declares
+template <size_t N>
+struct bytes {
+    uint8_t data[N];
+};
+
+namespace error {
+constexpr char unknown_command[1] = { 0 };
+constexpr char invalid_mod[1] = { 0 };
+constexpr char empty_argument[1] = { 0 };
+constexpr char invalid_argument[1] = { 0 };
+constexpr char invalid_number[1] = { 0 };
+constexpr char invalid_uuid[1] = { 0 };
+constexpr char no_default_delay[1] = { 0 };
+constexpr char delay_too_long[1] = { 0 };           // over MAX_ARG ms
+constexpr char string_too_long[1] = { 0 };          // over MAX_ARG chars
+constexpr char repeat_too_long[1] = { 0 };          // over MAX_ARG times
+constexpr char repeat_after_loop[1] = { 0 };        // change the LOOP count
+constexpr char loop_count_too_big[1] = { 0 };       // over MAX_ARG
+constexpr char loops_too_deep[1] = { 0 };           // over LOOP_DEPTH
+constexpr char loop_too_long[1] = { 0 };            // body over MAX_ARG bytes
+constexpr char endloop_without_loop[1] = { 0 };
+constexpr char loop_without_endloop[1] = { 0 };
+constexpr char more_than_one_trigger[1] = { 0 };
+constexpr char payload_too_long[1] = { 0 };         // over MAX_ARG bytes
+constexpr char untypeable_char[1] = { 0 };          // not on the layout
+// the subscript is the number of the payload, counting from 1
+constexpr char trigger_in_use[1] = { 0 };
+}
+
+typedef const char (*error_t)[1];
+
+// the layout hid.c types with, see layout.c
+constexpr uint8_t layout[256][2] = HID_LAYOUT;
+
+constexpr bool typeable(char c) {
+    return layout[static_cast<uint8_t>(c)][0] != 0;
+}
+
+constexpr char fail(error_t error, unsigned line) {
+    return *(*error + line);
+}
+
+// a run of characters in a script
+struct text {
+    const char *p;
+    size_t len;
+};
+
+constexpr size_t length(const char *s) {
+    size_t n = 0;
+    while (s[n] != '\0')
+        ++n;
+    return n;
+}
+
+constexpr char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// whether t is word, which is lower case, ignoring the case of t
+constexpr bool is(text t, const char *word) {
+    size_t i = 0;
+
+    for (i = 0; i < t.len; ++i)
+        if (word[i] == '\0' || lower(t.p[i]) != word[i])
+            return false;
+    return word[i] == '\0';
+}
+
+constexpr bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+constexpr text strip(text t) {
+    while (t.len > 0 && is_space(t.p[0])) {
+        ++t.p;
+        --t.len;
+    }
+    while (t.len > 0 && is_space(t.p[t.len - 1]))
+        --t.len;
+    return t;
+}
+
+// commands and the names of keys, as in script_gen.py
+constexpr const char *keywords[] = {
+    "rem", "gui", "string", "enter",
+    "default_delay", "defaultdelay",
+    "delay", "windows", "command", "menu", "app",
+    "shift", "alt", "control", "ctrl",
+    "leftarrow", "left", "rightarrow", "right",
+    "uparrow", "up", "downarrow", "down",
+    "tab", "esc", "escape", "backspace", "back",
+    "space", "repeat", "printscreen", "trigger",
+    "loop", "endloop",
+    "f1", "f2", "f3", "f4", "f5", "f6",
+    "f7", "f8", "f9", "f10", "f11", "f12",
+};
+
+constexpr const char *aliases[][2] = {
+    { "gui", "windows" },
+    { "command", "windows" },
+    { "defaultdelay", "default_delay" },
+    { "app", "menu" },
+    { "ctrl", "control" },
+    { "leftarrow", "left" },
+    { "rightarrow", "right" },
+    { "uparrow", "up" },
+    { "downarrow", "down" },
+};
+
+constexpr bool is_keyword(text t) {
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i)
+        if (is(t, keywords[i]))
+            return true;
+    return false;
+}
+
+constexpr text canonical(text t) {
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); ++i)
+        if (is(t, aliases[i][0]))
+            return text { aliases[i][1], length(aliases[i][1]) };
+    return t;
+}
+
+// modifier of a canonical command, 0 if it isn't one
+constexpr uint8_t modifier(text t) {
+    return is(t, "control") ? M_CTRL :
+           is(t, "shift") ? M_SHIFT :
+           is(t, "alt") ? M_ALT :
+           is(t, "windows") ? M_META : 0;
+}
+
+// a KEY op
+struct key {
+    uint8_t type;
+    uint8_t mod;
+    uint8_t chr;
+};
+
+// the key an argument names, mirrors clean_arg in script_gen.py
+// returns: nullptr on success or the error
+constexpr error_t parse_key(text arg, bool has_arg, key &k) {
+    k = key { K_RAW, 0, 0 };
+
+    if (!has_arg || arg.len == 0)
+        return &error::empty_argument;
+    if (arg.len == 1) {
+        k.type = K_CHAR;
+        k.chr = arg.p[0];
+        return nullptr;
+    }
+
+    arg = canonical(arg);
+    if (is(arg, "space")) {
+        k.type = K_CHAR;
+        k.chr = ' ';
+    } else if (is(arg, "enter")) {
+        k.type = K_ENTER;
+    } else if (is(arg, "tab")) {
+        k.type = K_TAB;
+    } else if (is(arg, "esc") || is(arg, "escape")) {
+        k.type = K_ESC;
+    } else if (is(arg, "backspace") || is(arg, "back")) {
+        k.type = K_BACK;
+    } else if (is(arg, "menu")) {
+        k.chr = 0x76;
+    } else if (is(arg, "printscreen")) {
+        k.chr = 0x46;
+    } else if (is(arg, "right")) {
+        k.chr = 0x4f;
+    } else if (is(arg, "left")) {
+        k.chr = 0x50;
+    } else if (is(arg, "down")) {
+        k.chr = 0x51;
+    } else if (is(arg, "up")) {
+        k.chr = 0x52;
+    } else if (lower(arg.p[0]) == 'f') {
+        unsigned n = 0;
+        for (size_t i = 1; i < arg.len; ++i) {
+            if (arg.p[i] < '0' || arg.p[i] > '9' || n > 12)
+                return &error::invalid_argument;
+            n = n * 10 + arg.p[i] - '0';
+        }
+        if (n < 1 || n > 12)
+            return &error::invalid_argument;
+        k.chr = 0x3a + n - 1;
+    } else {
+        return &error::invalid_argument;
+    }
+
+    return nullptr;
+}
+
+// a decimal argument, as int() in script_gen.py takes it
+// returns: nullptr on success or the error
+constexpr error_t parse_number(text arg, bool has_arg, uint32_t max, error_t too_big,
+                               uint32_t &value) {
+    uint64_t v = 0;
+
+    value = 0;
+    arg = strip(arg);
+    if (arg.len > 0 && arg.p[0] == '+') {
+        ++arg.p;
+        --arg.len;
+    }
+    if (!has_arg || arg.len == 0)
+        return &error::invalid_number;
+
+    for (size_t i = 0; i < arg.len; ++i) {
+        if (arg.p[i] < '0' || arg.p[i] > '9')
+            return &error::invalid_number;
+        v = v * 10 + arg.p[i] - '0';
+        if (v > max)
+            return too_big;
+    }
+    value = v;
+    return nullptr;
+}
+
+constexpr int hex_digit(char c) {
+    return c >= '0' && c <= '9' ? c - '0' :
+           lower(c) >= 'a' && lower(c) <= 'f' ? lower(c) - 'a' + 10 : -1;
+}
+
+// a trigger UUID in the byte order of an advertising packet
+// returns: nullptr on success or the error
+constexpr error_t parse_uuid(text arg, bool has_arg, uint8_t *magic) {
+    unsigned digits = 0;
+
+    arg = strip(arg);
+    if (!has_arg || arg.len < 2)
+        return &error::invalid_uuid;
+    if (arg.p[0] == '{' && arg.p[arg.len - 1] == '}') {
+        ++arg.p;
+        arg.len -= 2;
+    }
+
+    for (size_t i = 0; i < arg.len; ++i) {
+        int d = hex_digit(arg.p[i]);
+        if (arg.p[i] == '-')
+            continue;
+        if (d < 0 || digits == 32)
+            return &error::invalid_uuid;
+        if (digits % 2 == 0)
+            magic[15 - digits / 2] = d << 4;
+        else
+            magic[15 - digits / 2] |= d;
+        ++digits;
+    }
+
+    return digits == 32 ? nullptr : &error::invalid_uuid;
+}
+
+// where bytecode goes, counted but not stored when data is null
+struct output {
+    uint8_t *data;
+    size_t len;
+
+    constexpr void put(uint8_t b) {
+        if (data != nullptr)
+            data[len] = b;
+        ++len;
+    }
+
+    constexpr void put16(uint32_t w) {
+        put(w & 0xff);
+        put(w >> 8);
+    }
+
+    constexpr void set16(size_t pos, uint32_t w) {
+        if (data != nullptr) {
+            data[pos] = w & 0xff;
+            data[pos + 1] = w >> 8;
+        }
+    }
+};
+
+// what the index needs to know about a payload
+struct payload {
+    bool triggered;
+    uint8_t magic[16];
+};
+
+// kinds of command, for what REPEAT may follow
+enum last_t { CMD_NONE, CMD_LOOP, CMD_ENDLOOP, CMD_OTHER };
+
+// compiles a payload a line at a time, mirrors load_script and
+// ducky_to_bin in script_gen.py
+struct compiler {
+    output &out;
+    payload info;
+    unsigned line;
+    unsigned triggers;
+    bool have_default_delay;
+    uint32_t default_delay;
+    last_t last;
+    unsigned depth;                 // of LOOPs
+    size_t loops[LOOP_DEPTH];       // where the skip of each open LOOP goes
+
+    constexpr void emit_key(key k) {
+        if (k.type == K_CHAR && !typeable(k.chr))
+            fail(&error::untypeable_char, line);
+        out.put(OP_KEY);
+        out.put(k.type);
+        out.put(k.mod);
+        out.put(k.chr);
+        last = CMD_OTHER;
+    }
+
+    constexpr void check(error_t e) {
+        if (e != nullptr)
+            fail(e, line);
+    }
+
+    constexpr void statement(text cmd, text arg, bool has_arg) {
+        key k = { 0, 0, 0 };
+        uint32_t n = 0;
+
+        if (cmd.len == 0)
+            return;
+
+        // several modifiers, CTRL-ALT DEL
+        for (size_t i = 0; i < cmd.len; ++i) {
+            if (cmd.p[i] != '-')
+                continue;
+
+            uint8_t mod = 0;
+            size_t start = 0;
+            for (size_t j = 0; j <= cmd.len; ++j) {
+                if (j < cmd.len && cmd.p[j] != '-')
+                    continue;
+                text part = { cmd.p + start, j - start };
+                if (is_keyword(part)) {
+                    if (modifier(canonical(part)) == 0)
+                        fail(&error::invalid_mod, line);
+                    mod |= modifier(canonical(part));
+                }
+                start = j + 1;
+            }
+
+            check(parse_key(arg, has_arg, k));
+            k.mod |= mod;
+            emit_key(k);
+            return;
+        }
+
+        cmd = canonical(cmd);
+        if (!is_keyword(cmd))
+            fail(&error::unknown_command, line);
+
+        // modifier key, alone or with a key
+        if (modifier(cmd) != 0) {
+            if (parse_key(arg, has_arg, k) != nullptr)
+                k = key { K_RAW, 0, 0 };
+            k.mod |= modifier(cmd);
+            emit_key(k);
+        }
+
+        else if (is(cmd, "rem")) {
+        }
+
+        // UUID that runs this payload, Uberducky extension
+        else if (is(cmd, "trigger")) {
+            if (++triggers > 1)
+                fail(&error::more_than_one_trigger, line);
+            check(parse_uuid(arg, has_arg, info.magic));
+            info.triggered = true;
+            last = CMD_OTHER;
+        }
+
+        else if (is(cmd, "string")) {
+            if (!has_arg)
+                fail(&error::empty_argument, line);
+            if (arg.len > MAX_ARG)
+                fail(&error::string_too_long, line);
+            for (size_t i = 0; i < arg.len; ++i)
+                if (!typeable(arg.p[i]))
+                    fail(&error::untypeable_char, line);
+            if (arg.len > 0) {
+                out.put(OP_STRING);
+                out.put16(arg.len);
+                for (size_t i = 0; i < arg.len; ++i)
+                    out.put(arg.p[i]);
+                last = CMD_OTHER;
+            }
+        }
+
+        else if (is(cmd, "default_delay")) {
+            check(parse_number(arg, has_arg, 0xffffffff, &error::invalid_number, n));
+            default_delay = n;
+            have_default_delay = true;
+        }
+
+        else if (is(cmd, "delay")) {
+            if (has_arg)
+                check(parse_number(arg, has_arg, MAX_ARG, &error::delay_too_long, n));
+            else if (have_default_delay)
+                n = default_delay;
+            else
+                fail(&error::no_default_delay, line);
+            if (n > MAX_ARG)
+                fail(&error::delay_too_long, line);
+            out.put(OP_DELAY);
+            out.put16(n);
+            last = CMD_OTHER;
+        }
+
+        else if (is(cmd, "repeat")) {
+            n = 1;
+            if (has_arg)
+                check(parse_number(arg, has_arg, MAX_ARG, &error::repeat_too_long, n));
+            if (last == CMD_LOOP || last == CMD_ENDLOOP)
+                fail(&error::repeat_after_loop, line);
+            out.put(OP_REPEAT);
+            out.put16(n);
+            last = CMD_OTHER;
+        }
+
+        // block of commands run count times, Uberducky extension
+        else if (is(cmd, "loop")) {
+            check(parse_number(arg, has_arg, MAX_ARG, &error::loop_count_too_big, n));
+            if (depth == LOOP_DEPTH)
+                fail(&error::loops_too_deep, line);
+            out.put(OP_LOOP);
+            out.put16(n);
+            // the bytes to skip for LOOP 0 are filled in at the ENDLOOP
+            loops[depth++] = out.len;
+            out.put16(0);
+            last = CMD_LOOP;
+        }
+
+        else if (is(cmd, "endloop")) {
+            if (depth == 0)
+                fail(&error::endloop_without_loop, line);
+            out.put(OP_ENDLOOP);
+            --depth;
+            n = out.len - (loops[depth] + 2);
+            if (n > MAX_ARG)
+                fail(&error::loop_too_long, line);
+            out.set16(loops[depth], n);
+            last = CMD_ENDLOOP;
+        }
+
+        // a key on its own
+        else {
+            check(parse_key(cmd, true, k));
+            emit_key(k);
+        }
+    }
+};
+
+// compile a payload into out, its length followed by its bytecode
+constexpr payload compile(const char *src, output &out) {
+    compiler c = { out, { false, { 0 } }, 0, 0, false, 0, CMD_NONE, 0, { 0 } };
+    size_t start = out.len, pos = 0;
+
+    out.put16(0);
+
+    while (src[pos] != '\0') {
+        size_t end = pos, split = 0;
+        text cmd = { src + pos, 0 }, arg = { nullptr, 0 };
+        bool has_arg = false;
+
+        while (src[end] != '\0' && src[end] != '\n')
+            ++end;
+        ++c.line;
+
+        // the line without its line ending, split at the first space
+        cmd.len = end - pos;
+        while (cmd.len > 0 && cmd.p[cmd.len - 1] == '\r')
+            --cmd.len;
+        for (split = 0; split < cmd.len && cmd.p[split] != ' '; ++split)
+            ;
+        if (split < cmd.len) {
+            arg = text { cmd.p + split + 1, cmd.len - split - 1 };
+            has_arg = true;
+            cmd.len = split;
+        }
+
+        c.statement(cmd, arg, has_arg);
+        pos = src[end] != '\0' ? end + 1 : end;
+    }
+
+    if (c.depth != 0)
+        fail(&error::loop_without_endloop, c.line);
+    if (out.len - start - 2 > MAX_ARG)
+        fail(&error::payload_too_long, c.line);
+    out.set16(start, out.len - start - 2);
+
+    return c.info;
+}
+
+// size of the script array for some payloads
+template <size_t C>
+constexpr size_t script_size(const char *const (&sources)[C]) {
+    output out = { nullptr, 0 };
+
+    for (size_t i = 0; i < C; ++i)
+        compile(sources[i], out);
+    return out.len;
+}
+
+// the payloads one after another, as script_gen.py lays them out
+template <size_t N, size_t C>
+constexpr bytes<N> build_script(const char *const (&sources)[C]) {
+    bytes<N> script = { { 0 } };
+    output out = { script.data, 0 };
+
+    for (size_t i = 0; i < C; ++i)
+        compile(sources[i], out);
+    return script;
+}
+
+// the payload index, see build_index in script_gen.py
+template <size_t C>
+constexpr bytes<2 + C * 20> build_index(const char *const (&sources)[C]) {
+    static_assert(C <= PAYLOAD_MAX, "more payloads than the firmware has triggers for");
+
+    bytes<2 + C * 20> index = { { 0 } };
+    payload info[C] = { };
+    output out = { nullptr, 0 };
+
+    index.data[0] = C & 0xff;
+    index.data[1] = C >> 8;
+
+    for (size_t i = 0; i < C; ++i) {
+        uint8_t *entry = index.data + 2 + i * 20;
+        size_t offset = out.len;
+
+        info[i] = compile(sources[i], out);
+
+        for (size_t j = 0; j < i; ++j) {
+            bool same = info[i].triggered == info[j].triggered;
+            for (size_t b = 0; b < 16; ++b)
+                same = same && info[i].magic[b] == info[j].magic[b];
+            if (same)
+                fail(&error::trigger_in_use, i + 1);
+        }
+
+        for (size_t b = 0; b < 16; ++b)
+            entry[b] = info[i].magic[b];
+        for (size_t b = 0; b < 4; ++b)
+            entry[16 + b] = offset >> (b * 8);
+    }
+
+    return index;
+}
+
+}
+
+// define script and script_index from one or more payloads of duckyscript,
+// each a string literal
+#define DUCKY_SCRIPT(...) \
+    static constexpr const char *ducky_sources[] = { __VA_ARGS__ }; \
+    extern "C" constexpr ducky::bytes<ducky::script_size(ducky_sources)> script = \
+        ducky::build_script<ducky::script_size(ducky_sources)>(ducky_sources); \
+    extern "C" constexpr auto script_index = ducky::build_index(ducky_sources)
+
+#endif /* __DUCKY_HPP__ */
@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+
+# Copyright 2019 Mike Ryan
+#
+# This file is part of Uberducky and is released under the terms of the
+# GPL version 2. Refer to COPYING for more information.
+
+# Uploads payloads to an Uberducky built with OTA=1 over the air. The image
+# made by script_gen.py --image is sent as BLE advertisements from a local
+# Bluetooth controller through a raw HCI socket, so this needs root and a
+# controller that is not advertising for anything else.
+#
+# The chunks are sent round after round, in a new order each round, until
+# the image has been sent --rounds times. If Uberducky is also plugged in
+# to this host, its counters are read over USB (needs pyusb) after every
+# round, sending stops as soon as it has written the image, and the chunks
+# it lost are reported.
+#
+# The image is signed with the key the firmware was built with, make OTA=1
+# OTA_KEY=... takes the same 32 hex digits as --key.
+#
+# The packet format is defined in ota.h.
+
+from __future__ import print_function
+
+import argparse
+import binascii
+import random
+import socket
+import struct
+import sys
+import time
+import uuid
+import zlib
+
+OTA_MAGIC = uuid.UUID('7b0e5c1a-3d92-4f6b-a8e4-2c61d09f5b37').bytes[::-1]
+OTA_CHUNK_DATA = 14
+OTA_MAX_LEN = 2048
+
+AD_SERVICE_DATA_128 = 0x21
+
+HCI_COMMAND_PKT = 0x01
+HCI_EVENT_PKT = 0x04
+EVT_CMD_COMPLETE = 0x0e
+
+LE_SET_ADV_PARAMS = 0x2006
+LE_SET_ADV_DATA = 0x2008
+LE_SET_ADV_ENABLE = 0x200a
+
+ADV_NONCONN_IND = 0x03
+ALL_ADV_CHANNELS = 0x07
+
+class Hci(object):
+    def __init__(self, dev):
+        self.sock = socket.socket(socket.AF_BLUETOOTH, socket.SOCK_RAW,
+                                  socket.BTPROTO_HCI)
+        self.sock.bind((dev,))
+        # hci_ufilter: only command complete events
+        self.sock.setsockopt(socket.SOL_HCI, socket.HCI_FILTER,
+                             struct.pack('<IIIH', 1 << HCI_EVENT_PKT,
+                                         1 << EVT_CMD_COMPLETE, 0, 0))
+        self.sock.settimeout(1.0)
+
+    # send a command and wait for it to complete
+    def command(self, opcode, params):
+        self.sock.send(struct.pack('<BHB', HCI_COMMAND_PKT, opcode, len(params)) + params)
+        while True:
+            event = self.sock.recv(260)
+            # type, event, length, credits, opcode, status
+            if len(event) >= 7 and struct.unpack('<H', event[4:6])[0] == opcode:
+                status = bytearray(event)[6]
+                if status != 0:
+                    raise Exception("HCI command 0x%04x failed with status 0x%02x" %
+                                    (opcode, status))
+                return
+
+    def adv_params(self, interval_ms):
+        interval = int(interval_ms / 0.625)
+        self.command(LE_SET_ADV_PARAMS,
+                     struct.pack('<HHBBB6sBB', interval, interval, ADV_NONCONN_IND,
+                                 0, 0, b'\0' * 6, ALL_ADV_CHANNELS, 0))
+
+    def adv_data(self, ad):
+        self.command(LE_SET_ADV_DATA, struct.pack('B', len(ad)) + ad.ljust(31, b'\0'))
+
+    def adv_enable(self, enable):
+        self.command(LE_SET_ADV_ENABLE, struct.pack('B', enable))
+
+MASK64 = 0xffffffffffffffff
+
+def rotl(x, b):
+    return ((x << b) | (x >> (64 - b))) & MASK64
+
+# SipHash-2-4 of data under a 16 byte key, as ota_mac in ota.c
+def siphash(key, data):
+    k0, k1 = struct.unpack('<QQ', key)
+    v = [k0 ^ 0x736f6d6570736575, k1 ^ 0x646f72616e646f6d,
+         k0 ^ 0x6c7967656e657261, k1 ^ 0x7465646279746573]
+
+    def rounds(n):
+        for i in range(n):
+            v[0] = (v[0] + v[1]) & MASK64
+            v[1] = rotl(v[1], 13) ^ v[0]
+            v[0] = rotl(v[0], 32)
+            v[2] = (v[2] + v[3]) & MASK64
+            v[3] = rotl(v[3], 16) ^ v[2]
+            v[0] = (v[0] + v[3]) & MASK64
+            v[3] = rotl(v[3], 21) ^ v[0]
+            v[2] = (v[2] + v[1]) & MASK64
+            v[1] = rotl(v[1], 17) ^ v[2]
+            v[2] = rotl(v[2], 32)
+
+    # the last 0 to 7 bytes are padded out with the length in the top byte
+    tail = len(data) // 8 * 8
+    padded = data[:tail] + data[tail:].ljust(7, b'\0') + struct.pack('B', len(data) & 0xff)
+    for i in range(0, len(padded), 8):
+        m = struct.unpack('<Q', padded[i:i + 8])[0]
+        v[3] ^= m
+        rounds(2)
+        v[0] ^= m
+
+    v[2] ^= 0xff
+    rounds(4)
+    return v[0] ^ v[1] ^ v[2] ^ v[3]
+
+# the chunk data, MAC, image length and CRC followed by the image
+def make_chunks(image, key):
+    data = struct.pack('<HI', len(image), zlib.crc32(image) & 0xffffffff) + image
+    data = struct.pack('<Q', siphash(key, data)) + data
+    data = data.ljust((len(data) + OTA_CHUNK_DATA - 1) // OTA_CHUNK_DATA * OTA_CHUNK_DATA, b'\0')
+    return [data[i:i + OTA_CHUNK_DATA] for i in range(0, len(data), OTA_CHUNK_DATA)]
+
+def announce_ad(session, count):
+    return struct.pack('<BB16sBH', 20, AD_SERVICE_DATA_128, OTA_MAGIC, session, count)
+
+def chunk_ad(session, n, data):
+    return struct.pack('<BBHBH14s', 20, 0xff, 0xffff, session, n, data)
+
+# Uberducky on USB, or None if it or pyusb is missing
+def find_ducky():
+    try:
+        import usb.core
+        import ducky_stats
+    except ImportError:
+        return None
+
+    dev = usb.core.find(idVendor=ducky_stats.VENDOR_ID, idProduct=ducky_stats.PRODUCT_ID,
+                        custom_match=ducky_stats.is_uberducky)
+    if dev is None:
+        return None
+    if ducky_stats.read_stats(dev)[0] != ducky_stats.STATS_VERSION:
+        return None
+
+    def counters():
+        return ducky_stats.counter_values(ducky_stats.read_stats(dev))
+    return counters
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Upload payloads to Uberducky over BLE')
+    parser.add_argument('image', help='output of script_gen.py --image')
+    parser.add_argument('-k', '--key', required=True,
+                        help='32 hex digits, the OTA_KEY the firmware was built with')
+    parser.add_argument('-i', '--hci', type=int, default=0,
+                        help='HCI device number, default 0 for hci0')
+    parser.add_argument('--interval', type=float, default=20,
+                        help='advertising interval in ms, default 20')
+    parser.add_argument('--repeat', type=int, default=1,
+                        help='advertising events each chunk is sent for, default 1')
+    parser.add_argument('--rounds', type=int, default=10,
+                        help='most times to send the whole image, default 10')
+    args = parser.parse_args()
+
+    try:
+        image = open(args.image, 'rb').read()
+        if len(image) == 0 or len(image) > OTA_MAX_LEN:
+            raise Exception("image is %d bytes, must be 1 to %d" % (len(image), OTA_MAX_LEN))
+
+        try:
+            key = binascii.unhexlify(args.key)
+        except (TypeError, ValueError):
+            key = b''
+        if len(key) != 16:
+            raise Exception("key must be 32 hex digits")
+
+        chunks = make_chunks(image, key)
+        session = random.randrange(256)
+        counters = find_ducky()
+        before = counters() if counters else None
+        dwell = args.interval * args.repeat / 1000.0
+
+        hci = Hci(args.hci)
+        hci.adv_enable(0)
+        hci.adv_params(args.interval)
+        hci.adv_data(announce_ad(session, len(chunks)))
+        hci.adv_enable(1)
+
+        sent = 0
+        rounds = 0
+        after = None
+        start = time.time()
+        try:
+            while rounds < args.rounds:
+                # the announcement starts every round, in case the first
+                # ones were missed
+                hci.adv_data(announce_ad(session, len(chunks)))
+                time.sleep(dwell)
+                for n in random.sample(range(len(chunks)), len(chunks)):
+                    hci.adv_data(chunk_ad(session, n, chunks[n]))
+                    time.sleep(dwell)
+                    sent += 1
+                rounds += 1
+
+                if counters:
+                    after = counters()
+                    if after['ota_commits'] != before['ota_commits'] or \
+                            after['ota_failures'] != before['ota_failures']:
+                        break
+        finally:
+            hci.adv_enable(0)
+        elapsed = time.time() - start
+    except Exception as e:
+        print("Upload failed: %s" % e)
+        sys.exit(1)
+
+    print('image             %6d bytes in %d chunks' % (len(image), len(chunks)))
+    print('sent              %6d chunks in %d rounds, %.1f s' % (sent, rounds, elapsed))
+    print('retransmissions   %6.1f%% of chunks sent' % (100.0 * (sent - len(chunks)) / sent))
+
+    if after is None:
+        print('Uberducky not found on USB, sent the image %d times' % rounds)
+        sys.exit(0)
+
+    received = after['ota_chunks'] - before['ota_chunks']
+    dups = after['ota_duplicates'] - before['ota_duplicates']
+    print('received          %6d chunks, %d again' % (received, dups))
+    print('lost              %6.1f%% of chunks sent' % (100.0 * (sent - received - dups) / sent))
+
+    if after['ota_commits'] != before['ota_commits']:
+        print('effective rate    %6.1f bytes/s' % (len(image) / elapsed))
+    else:
+        print('Upload failed: %s' % ('image rejected, wrong key, bad CRC or flash write failed'
+                                    if after['ota_failures'] != before['ota_failures']
+                                    else 'not all chunks received'))
+        sys.exit(1)
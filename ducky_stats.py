@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+
+# Copyright 2019 Mike Ryan
+#
+# This file is part of Uberducky and is released under the terms of the
+# GPL version 2. Refer to COPYING for more information.
+
+# Reads the radio and trigger statistics from a running Uberducky over USB
+# and prints them. With --reset, clears them afterwards. Needs pyusb.
+#
+# The layout of the counters is defined in stats.h.
+
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+
+import usb.core
+import usb.util
+
+VENDOR_ID = 0x05ac
+PRODUCT_ID = 0x2227
+
+STATS_REQ_GET = 0x01
+STATS_REQ_RESET = 0x02
+
+# vendor request to the device
+REQ_IN = 0xc0
+REQ_OUT = 0x40
+
+# layout version, and the words before the counters: the version and the
+# number of counters
+STATS_VERSION = 1
+HEADER_WORDS = 2
+
+# firmware may have fewer counters than this, if older, or more, if newer
+COUNTERS = [
+    ('packets', 'valid advertisements'),
+    ('bad_header', 'rejected by PDU header'),
+    ('bad_crc', 'rejected by CRC'),
+    ('rx_overruns', 'dropped, main loop too slow'),
+    ('radio_timeouts', 'radio restarts'),
+    ('report_queue_full', 'HID report queue filled up'),
+    ('loop_max', 'longest main loop (us)'),
+    ('trigger_latency', 'last trigger latency (us)'),
+    ('trigger_latency_max', 'worst trigger latency (us)'),
+    ('ota_chunks', 'upload chunks received'),
+    ('ota_duplicates', 'upload chunks received again'),
+    ('ota_commits', 'uploads written to flash'),
+    ('ota_failures', 'uploads failed'),
+    ('rate_down_time', 'typing rate, ms per report'),
+    ('rate_lag', 'last lock key echo lag (ms)'),
+    ('rate_probes', 'typing rate probes'),
+    ('rate_timeouts', 'probes not echoed'),
+    ('abort_latency', 'last abort latency (us)'),
+    ('abort_latency_max', 'worst abort latency (us)'),
+    ('payloads_untriggered', 'payloads with no trigger slot'),
+]
+
+CHANNELS = [37, 38, 39]
+CHANNEL_WORDS = 4
+
+# the VID and PID are an Apple keyboard's, so check the product string too
+def is_uberducky(dev):
+    try:
+        return usb.util.get_string(dev, dev.iProduct) == 'Uberducky'
+    except (usb.core.USBError, ValueError):
+        return False
+
+def read_stats(dev):
+    data = dev.ctrl_transfer(REQ_IN, STATS_REQ_GET, 0, 0, 1024)
+    return struct.unpack('<%dI' % (len(data) // 4), bytes(bytearray(data)))
+
+# counters by name, those the firmware doesn't have are left out
+def counter_values(words):
+    return dict((name, words[HEADER_WORDS + i])
+                for i, (name, _) in enumerate(COUNTERS[:words[1]]))
+
+def print_stats(words):
+    for i in range(words[1]):
+        desc = COUNTERS[i][1] if i < len(COUNTERS) else 'counter %d' % i
+        print('%-28s %10d' % (desc, words[HEADER_WORDS + i]))
+
+    print()
+    print('channel  packets  triggers  mean ms to trigger  max ms to trigger')
+    base = HEADER_WORDS + words[1]
+    for i, channel in enumerate(CHANNELS):
+        packets, triggers, total, worst = words[base:base + CHANNEL_WORDS]
+        mean = total / 1000.0 / triggers if triggers else 0.0
+        print('%7d %8d %9d %19.3f %18.3f' % (channel, packets, triggers, mean,
+                                             worst / 1000.0))
+        base += CHANNEL_WORDS
+
+    # trigger_init registers the built in triggers first
+    builtin = ['bootloader', 'abort', 'pause', 'resume']
+    count = min(words[base], len(words) - base - 1)
+    print()
+    for i in range(count):
+        if i < len(builtin):
+            name = builtin[i]
+        else:
+            name = 'trigger %d' % (i - len(builtin) + 1)
+        print('%-28s %10d' % (name + ' hits', words[base + 1 + i]))
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Read Uberducky statistics')
+    parser.add_argument('--reset', action='store_true',
+                        help='clear the counters after reading them')
+    args = parser.parse_args()
+
+    dev = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID,
+                        custom_match=is_uberducky)
+    if dev is None:
+        print("Uberducky not found")
+        sys.exit(1)
+
+    words = read_stats(dev)
+    if len(words) < HEADER_WORDS or words[0] != STATS_VERSION:
+        print("Unknown statistics layout, ducky_stats.py is for version %d" % STATS_VERSION)
+        sys.exit(1)
+
+    print_stats(words)
+
+    if args.reset:
+        dev.ctrl_transfer(REQ_OUT, STATS_REQ_RESET, 0, 0)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Copyright 2019 Mike Ryan
+#
+# This file is part of Uberducky and is released under the terms of the
+# GPL version 2. Refer to COPYING for more information.
+
+# Uploads payloads to a running Uberducky over USB, replacing the ones built
+# into the firmware until the next upload. The firmware must be built with
+# UPLOAD=1. The image is made by script_gen.py --image. Needs pyusb.
+#
+# The requests are defined in upload.h.
+
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+import usb.core
+import usb.util
+
+VENDOR_ID = 0x05ac
+PRODUCT_ID = 0x2227
+
+UPLOAD_REQ_START = 0x10
+UPLOAD_REQ_DATA = 0x11
+UPLOAD_REQ_END = 0x12
+
+UPLOAD_CHUNK = 64
+UPLOAD_MAX_LEN = 0x2000 - 256
+
+# vendor request to the device
+REQ_OUT = 0x40
+
+# the device stalls a chunk while it erases flash for the upload, up to
+# 100 ms a sector, or while both of its page buffers wait for flash
+RETRIES = 500
+
+# the VID and PID are an Apple keyboard's, so check the product string too
+def is_uberducky(dev):
+    try:
+        return usb.util.get_string(dev, dev.iProduct) == 'Uberducky'
+    except (usb.core.USBError, ValueError):
+        return False
+
+# 32 bit argument split over wValue and wIndex
+def request(dev, req, value, data=None):
+    dev.ctrl_transfer(REQ_OUT, req, value & 0xffff, value >> 16, data)
+
+def send_chunk(dev, n, chunk):
+    for i in range(RETRIES):
+        try:
+            dev.ctrl_transfer(REQ_OUT, UPLOAD_REQ_DATA, n, 0, chunk)
+            return
+        except usb.core.USBError:
+            time.sleep(0.001)
+    raise Exception("chunk %d not accepted" % n)
+
+def upload(dev, image):
+    try:
+        request(dev, UPLOAD_REQ_START, len(image))
+    except usb.core.USBError:
+        raise Exception("upload refused, is a payload running?")
+
+    for n in range(0, (len(image) + UPLOAD_CHUNK - 1) // UPLOAD_CHUNK):
+        send_chunk(dev, n, image[n * UPLOAD_CHUNK:(n + 1) * UPLOAD_CHUNK])
+
+    try:
+        request(dev, UPLOAD_REQ_END, zlib.crc32(image) & 0xffffffff)
+    except usb.core.USBError:
+        raise Exception("image failed to verify, the built in payloads are in use")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Upload payloads to Uberducky')
+    parser.add_argument('image', help='output of script_gen.py --image')
+    args = parser.parse_args()
+
+    try:
+        image = open(args.image, 'rb').read()
+        if len(image) == 0 or len(image) > UPLOAD_MAX_LEN:
+            raise Exception("image is %d bytes, must be 1 to %d" % (len(image), UPLOAD_MAX_LEN))
+
+        dev = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID,
+                            custom_match=is_uberducky)
+        if dev is None:
+            raise Exception("Uberducky not found")
+
+        upload(dev, image)
+    except Exception as e:
+        print("Upload failed: %s" % e)
+        sys.exit(1)
+
+    print("Uploaded %d bytes" % len(image))
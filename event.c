@@ -0,0 +1,54 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "event.h"
+
+#include <stddef.h>
+
+// Single producer, single consumer ring: the main loop decodes the script
+// into it and TIMER0_IRQHandler takes the events out. Each side only writes
+// its own index, so neither has to mask the other.
+
+static script_event_t ring[EVENT_RING_LEN];
+static volatile unsigned head = 0;  // written by the producer
+static volatile unsigned tail = 0;  // written by the consumer
+
+// keep the compiler from moving accesses to an event past the index update
+// that hands it to the other side
+#define BARRIER() asm volatile ("" ::: "memory")
+
+// empty the ring, only while the consumer is not taking events
+void event_reset(void) {
+    head = tail = 0;
+}
+
+// the next free event for the producer to fill in, or NULL if the ring is full
+script_event_t *event_slot(void) {
+    if (head - tail == EVENT_RING_LEN)
+        return NULL;
+    return &ring[head % EVENT_RING_LEN];
+}
+
+// hand the event from event_slot to the consumer
+void event_push(void) {
+    BARRIER();
+    ++head;
+}
+
+// the oldest event, or NULL if the ring is empty
+script_event_t *event_peek(void) {
+    if (tail == head)
+        return NULL;
+    BARRIER();
+    return &ring[tail % EVENT_RING_LEN];
+}
+
+// hand the event from event_peek back to the producer
+void event_pop(void) {
+    BARRIER();
+    ++tail;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include <stdint.h>
+
+// events the script is decoded into ahead of time, must be a power of 2
+#define EVENT_RING_LEN 16
+
+// a report and when to send it
+typedef struct _script_event_t {
+    uint32_t delay;     // ms to wait once the host has read every report
+                        // before this one, 0 to queue it straight away
+    uint8_t end;        // end of the script, the report is not sent
+    uint8_t report[8];
+} script_event_t;
+
+void event_reset(void);
+script_event_t *event_slot(void);
+void event_push(void);
+script_event_t *event_peek(void);
+void event_pop(void);
+
+#endif /* __EVENT_H__ */
@@ -5,87 +5,34 @@
  * GPL version 2. Refer to COPYING for more information.
  */
 
-#include <ctype.h>
 #include <string.h>
 
 #include "hid.h"
 
-typedef struct _enc_t {
-    uint8_t val;
-    int shift;
-} enc_t;
-
-// 0x20 - 0x40
-enc_t enc_20[] = {
-    { 0x2c, 0 } /*   */, { 0x1e, 1 } /* ! */, { 0x34, 1 } /* " */,
-    { 0x20, 1 } /* # */, { 0x21, 1 } /* $ */, { 0x22, 1 } /* % */,
-    { 0x24, 1 } /* & */, { 0x34, 0 } /* ' */, { 0x26, 1 } /* ( */,
-    { 0x27, 1 } /* ) */, { 0x25, 1 } /* * */, { 0x2e, 1 } /* + */,
-    { 0x36, 0 } /* , */, { 0x2d, 0 } /* - */, { 0x37, 0 } /* . */,
-    { 0x38, 0 } /* / */, { 0x27, 0 } /* 0 */, { 0x1e, 0 } /* 1 */,
-    { 0x1f, 0 } /* 2 */, { 0x20, 0 } /* 3 */, { 0x21, 0 } /* 4 */,
-    { 0x22, 0 } /* 5 */, { 0x23, 0 } /* 6 */, { 0x24, 0 } /* 7 */,
-    { 0x25, 0 } /* 8 */, { 0x26, 0 } /* 9 */, { 0x33, 1 } /* : */,
-    { 0x33, 0 } /* ; */, { 0x36, 1 } /* < */, { 0x2e, 0 } /* = */,
-    { 0x37, 1 } /* > */, { 0x38, 1 } /* ? */, { 0x1f, 1 } /* @ */,
-};
-
-enc_t enc_5b[] = {
-    { 0x2f, 0 } /* [ */, { 0x31, 0 } /* \ */, { 0x30, 0 } /* ] */,
-    { 0x23, 1 } /* ^ */, { 0x2d, 1 } /* _ */, { 0x35, 0 } /* ` */,
-};
-
-enc_t enc_7b[] = {
-    { 0x2f, 1 } /* { */, { 0x31, 1 } /* | */, { 0x30, 1 } /* } */,
-    { 0x35, 1 } /* ~ */,
-};
+// HID usage and modifiers of each character, generated by layout_gen.py for
+// the keyboard layout chosen at build time
+extern const uint8_t hid_layout[256][2];
 
 // encode a single character for a HID report
-// input: l, a printable char to encode
+// input: l, a char to encode
 // output: o, a single uint8_t
-// returns: 0 normally, 1 if character requires shift
-// corner case: if non-printable char is input, will encode ' ' (space)
-static int encode_char(char l, uint8_t *o) {
-    int shift = 0;
-    enc_t *e;
-    if (l >= 0x20 && l <= 0x40) {
-        e = &enc_20[l-0x20];
-        shift = e->shift;
-        *o = e->val;
-    } else if (l >= 0x5b && l <= 0x60) {
-        e = &enc_5b[l-0x5b];
-        shift = e->shift;
-        *o = e->val;
-    } else if (l >= 0x7b && l <= 0x7e) {
-        e = &enc_7b[l-0x7b];
-        shift = e->shift;
-        *o = e->val;
-    } else if (isalpha(l)) { // a letter
-        if (isupper(l)) {
-            shift = 1;
-            l = tolower(l);
-        }
-        *o = l - 'a' + 0x04;
-    } else { // TODO error? encode a space i guess
-        return encode_char(' ', o);
-    }
-    return shift;
+// returns: modifiers the character must be typed with
+// corner case: chars the layout cannot type encode as 0 (no key), these are
+// rejected by script_gen.py
+static int encode_char(uint8_t l, uint8_t *o) {
+    *o = hid_layout[l][0];
+    return hid_layout[l][1];
 }
 
 // encode a keystroke into an 8-byte HID report
 void hid_encode(keystroke_t *s, uint8_t *r) {
     int mod = s->mod;
-    int shift;
-    char l;
-    enc_t *e;
 
     memset(r, 0, 8);
 
     switch (s->type) {
         case K_CHAR:
-            shift = encode_char(s->chr, &r[2]);
-            if (shift)
-                mod |= M_SHIFT;
+            mod |= encode_char(s->chr, &r[2]);
             break;
         case K_ENTER:
             r[2] = 0x28;
@@ -105,3 +52,44 @@ void hid_encode(keystroke_t *s, uint8_t *r) {
     }
     r[0] = mod;
 }
+
+// returns 1 if key is in the key array of report r
+static int key_held(uint8_t *r, uint8_t key) {
+    unsigned i;
+    for (i = 0; i < HID_MAX_KEYS; ++i)
+        if (r[2+i] == key)
+            return 1;
+    return 0;
+}
+
+// pack a run of characters into a single HID report
+// input: s, characters to encode, len, number of characters in s
+//        prev, the report that is currently held down
+// output: r, an 8-byte HID report
+// returns: number of characters consumed
+// corner case: returns 0 and an all keys up report in r if the keys in prev
+// must be released before the next character can be typed
+unsigned hid_encode_string(uint8_t *s, unsigned len, uint8_t *prev, uint8_t *r) {
+    unsigned n;
+    uint8_t key;
+    int mod;
+    int held = prev[2] != 0;
+
+    memset(r, 0, 8);
+
+    for (n = 0; n < len && n < HID_MAX_KEYS; ++n) {
+        mod = encode_char(s[n], &key);
+
+        // every key in a report shares the same modifiers, and a key that is
+        // already down does not register again until it is released
+        if (n > 0 && (mod != r[0] || key_held(r, key)))
+            break;
+        if (held && (mod != prev[0] || key_held(prev, key)))
+            break;
+
+        r[0] = mod;
+        r[2+n] = key;
+    }
+
+    return n;
+}
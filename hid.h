@@ -10,8 +10,16 @@
 
 #include <stdint.h>
 
-// time in ms a key is held down
+// time in ms a key is held down, which is also the interval at which the
+// host polls for reports
+#ifdef HIGH_RATE
+#define DOWN_TIME 1
+#else
 #define DOWN_TIME 10
+#endif
+
+// number of keys that fit in the key array of a report
+#define HID_MAX_KEYS 5
 
 // key types
 #define K_CHAR  0
@@ -27,6 +35,7 @@
 #define M_SHIFT 2
 #define M_ALT   4
 #define M_META  8
+#define M_ALTGR 0x40
 typedef struct _keystroke_t {
     int type;
     int mod;
@@ -34,5 +43,6 @@ typedef struct _keystroke_t {
 } keystroke_t;
 
 void hid_encode(keystroke_t *s, uint8_t *r);
+unsigned hid_encode_string(uint8_t *s, unsigned len, uint8_t *prev, uint8_t *r);
 
 #endif /* __HID_H__ */
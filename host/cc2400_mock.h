@@ -0,0 +1,29 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __CC2400_MOCK_H__
+#define __CC2400_MOCK_H__
+
+#include <stdint.h>
+
+#include "ble.h"
+
+// mock CC2400 radio: a packet loaded into the FIFO is reported by FSMSTATE
+// as received until it is read and the radio is strobed back into RX, and
+// raises the GIO6 interrupt as the real radio does at the end of a packet
+void mock_fifo_load(uint8_t *raw);
+
+// load a dewhitened packet as it would arrive on the channel the radio is
+// tuned to
+void mock_air_load(uint8_t *pkt);
+unsigned mock_channel(void);
+
+// whiten a dewhitened packet for a BLE channel and reverse the bit order
+// of each byte, giving the bytes the CC2400 would hold in its FIFO
+void mock_whiten(uint8_t *pkt, uint8_t *raw, unsigned len, unsigned channel);
+
+#endif /* __CC2400_MOCK_H__ */
@@ -0,0 +1,404 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Types the built in payloads into a simulated USB host and prints every
+// report the host reads, with the ms of simulated TIMER0 it read it at.
+//
+// The script engine, hid.c, the report queue and the payloads are the
+// firmware's own. This stands in for usb.c as the queue's interrupt
+// endpoint, which the host polls every bInterval (DOWN_TIME) ms, or every
+// frame with HIGH_RATE. The host toggles the keyboard LEDs when a
+// lock key goes down, -l ms later, so ADAPTIVE_RATE has an echo to go by.
+//
+// Each payload ends with the text the host saw and its timing. Given an
+// earlier trace with -c, the run fails if a payload now types different
+// text, takes longer or types slower than it did by more than -t percent,
+// or runs longer than -m seconds. With -a, each payload is aborted part way
+// through and the time until the host has read all keys up is printed.
+
+// the script engine is static, so build uberducky.c as part of this file
+#define main firmware_main
+#include "uberducky.c"
+#undef main
+
+#include "report_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the index and payloads, see build_index in script_gen.py
+extern const uint8_t script_index[];
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+
+// usb.c
+
+volatile uint8_t usb_leds = 0;
+
+static uint8_t ep_report[8];        // written to the endpoint
+static int ep_full = 0;
+
+void usb_init(void) {
+}
+
+void report_queue_write(const uint8_t *report) {
+    memcpy(ep_report, report, 8);
+    ep_full = 1;
+}
+
+// host
+
+#define LOCK_KEYS 3
+static const uint8_t lock_key[LOCK_KEYS] = { 0x53, 0x39, 0x47 };  // Num, Caps, Scroll
+
+// character typed by each key under no modifier, Shift, AltGr and both,
+// -1 if none
+static int typed[4][256];
+
+static unsigned echo_lag = 2;
+static uint8_t echo_leds = 0;       // LEDs to toggle
+static uint32_t echo_at = 0;
+
+static uint8_t held[8];             // last report read
+static int quiet = 0;
+
+// what the host saw of a payload
+typedef struct _trace_t {
+    char *text;
+    size_t text_len, text_size;
+    unsigned reports;
+    unsigned chars;
+    uint32_t runtime;               // ms until the last report was read
+    uint32_t aborted;               // ms the abort came at, 0 if none
+    uint32_t silent;                // ms the host read all keys up after it
+} trace_t;
+
+static int mod_class(int mod) {
+    if (mod & ~(M_SHIFT | M_ALTGR))
+        return -1;
+    return (mod & M_SHIFT ? 1 : 0) | (mod & M_ALTGR ? 2 : 0);
+}
+
+// invert the layout hid.c types with
+static void typed_init(void) {
+    static const struct {
+        int type;
+        char chr;
+    } named[] = {
+        { K_ENTER, '\n' }, { K_TAB, '\t' }, { K_ESC, 0x1b }, { K_BACK, '\b' },
+    };
+    keystroke_t k = { K_CHAR, M_NONE, 0 };
+    uint8_t r[8];
+    unsigned c, i;
+    int m;
+
+    memset(typed, 0xff, sizeof(typed));
+
+    for (c = 1; c < 256; ++c) {
+        k.chr = c;
+        hid_encode(&k, r);
+        m = mod_class(r[0]);
+        if (r[2] != 0 && m >= 0 && typed[m][r[2]] < 0)
+            typed[m][r[2]] = c;
+    }
+
+    for (i = 0; i < sizeof(named) / sizeof(named[0]); ++i) {
+        k.type = named[i].type;
+        hid_encode(&k, r);
+        if (typed[0][r[2]] < 0)
+            typed[0][r[2]] = named[i].chr;
+    }
+}
+
+static void text_add(trace_t *t, const char *s) {
+    size_t len = strlen(s);
+
+    if (t->text_len + len + 1 > t->text_size) {
+        t->text_size = (t->text_len + len + 1) * 2;
+        t->text = realloc(t->text, t->text_size);
+    }
+    memcpy(t->text + t->text_len, s, len + 1);
+    t->text_len += len;
+}
+
+// append a key to the text, escaped so the text stays on one line
+static void text_key(trace_t *t, int mod, uint8_t key) {
+    char s[16];
+    int m = mod_class(mod), c = m < 0 ? -1 : typed[m][key];
+
+    switch (c) {
+        case -1:   sprintf(s, "<%02x:%02x>", mod, key); break;
+        case '\n': strcpy(s, "\\n"); break;
+        case '\t': strcpy(s, "\\t"); break;
+        case '\b': strcpy(s, "\\b"); break;
+        case '\\': strcpy(s, "\\\\"); break;
+        case '"':  strcpy(s, "\\\""); break;
+        default:
+            if (c < 0x20 || c >= 0x7f)
+                sprintf(s, "\\x%02x", c);
+            else
+                sprintf(s, "%c", c);
+    }
+    text_add(t, s);
+    ++t->chars;
+}
+
+static int key_in(const uint8_t *r, uint8_t key) {
+    unsigned i;
+
+    for (i = 2; i < 8; ++i)
+        if (r[i] == key)
+            return 1;
+    return 0;
+}
+
+// the host reads the endpoint, every key that went down since the last
+// report types a character
+static void host_read(trace_t *t, uint32_t ms) {
+    unsigned i, l;
+
+    if (!quiet) {
+        printf("%8u", ms);
+        for (i = 0; i < 8; ++i)
+            printf(" %02x", ep_report[i]);
+        printf("\n");
+    }
+
+    for (i = 2; i < 8; ++i) {
+        uint8_t key = ep_report[i];
+        if (key == 0 || key_in(held, key))
+            continue;
+
+        for (l = 0; l < LOCK_KEYS && lock_key[l] != key; ++l)
+            ;
+        if (l < LOCK_KEYS) {
+            echo_leds ^= 1 << l;
+            echo_at = ms + echo_lag;
+#ifdef ADAPTIVE_RATE
+            // the rate probe isn't part of what the script types
+            if (key == RATE_PROBE_KEY)
+                continue;
+#endif
+        }
+
+        text_key(t, ep_report[0], key);
+    }
+
+    memcpy(held, ep_report, 8);
+    ++t->reports;
+    t->runtime = ms;
+}
+
+// one frame of the bus
+static void host_frame(trace_t *t, uint32_t ms) {
+    if (echo_leds != 0 && ms >= echo_at) {
+        usb_leds ^= echo_leds;
+        echo_leds = 0;
+    }
+
+#ifdef HIGH_RATE
+    // HIDHandleFrame
+    report_queue_frame();
+#endif
+
+    if (ms % DOWN_TIME != 0 || !ep_full)
+        return;
+
+    host_read(t, ms);
+    ep_full = 0;
+
+    // HIDHandleIntrIn
+    report_queue_in();
+}
+
+// run payload n to the end, a ms at a time, aborting it at abort_ms if it
+// is still running then
+// returns: 1 if it finished within max_ms
+static int run(unsigned n, trace_t *t, uint32_t max_ms, uint32_t abort_ms) {
+    uint32_t ms;
+
+    T0TC = 0;
+    T0MCR = 0;
+    report_queue_reset();
+    ep_full = 0;
+    usb_leds = echo_leds = 0;
+    memset(held, 0, sizeof(held));
+    memset(t, 0, sizeof(*t));
+    text_add(t, "");
+
+    script_start(n);
+
+    for (ms = 1; ms <= max_ms; ++ms) {
+        T0TC = ms;
+        if ((T0MCR & TMCR_MR0I) && T0MR0 == ms) {
+            T0IR = TIR_MR0_Interrupt;
+            TIMER0_IRQHandler();
+            T0IR = 0;
+        }
+
+        // as the main loop takes the abort trigger
+        if (ms == abort_ms && script_state != ST_IDLE) {
+            script_abort();
+            t->aborted = ms;
+        }
+
+        host_frame(t, ms);
+
+        if (t->aborted && !t->silent && usb_reports_pending() == 0)
+            t->silent = ms;
+
+        // the main loop keeps decoding until the ring is full
+        while (script_state == ST_RUNNING && script_decode() != 0)
+            ;
+
+        if (script_state == ST_IDLE && usb_reports_pending() == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static double chars_per_s(const trace_t *t) {
+    return t->runtime ? t->chars * 1000.0 / t->runtime : 0.0;
+}
+
+// the summary of each payload in a trace printed by an earlier run
+typedef struct _golden_t {
+    char *text;
+    unsigned reports, chars;
+    uint32_t runtime;
+    int have_time;
+} golden_t;
+
+static golden_t *golden_read(const char *path, unsigned count) {
+    golden_t *g = calloc(count, sizeof(*g));
+    FILE *f = fopen(path, "r");
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    unsigned n;
+    int off;
+    double cps;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    while ((len = getline(&line, &size, f)) > 0) {
+        if (line[len - 1] == '\n')
+            line[--len] = '\0';
+        if (sscanf(line, "payload %u %n", &n, &off) != 1 || n >= count)
+            continue;
+
+        if (strncmp(line + off, "text ", 5) == 0) {
+            free(g[n].text);
+            g[n].text = strdup(line + off + 5);
+        } else if (sscanf(line + off, "reports %u chars %u runtime_ms %u chars_per_s %lf",
+                          &g[n].reports, &g[n].chars, &g[n].runtime, &cps) == 4) {
+            g[n].have_time = 1;
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return g;
+}
+
+// returns: 1 if payload n has regressed against the golden trace
+static int regressed(unsigned n, const trace_t *t, const golden_t *g, double tolerance) {
+    char text[t->text_len + 3];
+    double cps = g->runtime ? g->chars * 1000.0 / g->runtime : 0.0;
+    int bad = 0;
+
+    sprintf(text, "\"%s\"", t->text);
+
+    if (g->text == NULL || !g->have_time) {
+        fprintf(stderr, "payload %u: not in the golden trace\n", n);
+        return 1;
+    }
+    if (strcmp(text, g->text) != 0) {
+        fprintf(stderr, "payload %u: text differs\n  was %s\n  now %s\n", n, g->text, text);
+        bad = 1;
+    }
+    if (t->runtime > g->runtime * (1 + tolerance / 100)) {
+        fprintf(stderr, "payload %u: runtime %u ms, was %u ms\n", n, t->runtime, g->runtime);
+        bad = 1;
+    }
+    if (chars_per_s(t) < cps * (1 - tolerance / 100)) {
+        fprintf(stderr, "payload %u: %.2f chars/s, was %.2f\n", n, chars_per_s(t), cps);
+        bad = 1;
+    }
+
+    return bad;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-q] [-c golden_trace] [-t tolerance_pct] [-l echo_lag_ms]\n"
+            "          [-m max_s] [-a abort_ms]\n"
+            "  -q prints only the text and timing of each payload\n"
+            "  -c fails on a payload that regressed against an earlier trace\n"
+            "  -t sets how much slower a payload may get, default 2%%\n"
+            "  -l sets how long the host takes to toggle the lock LEDs, default 2 ms\n"
+            "  -m sets how long a payload may run, default 600 s\n"
+            "  -a aborts each payload this many ms after it starts\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *golden_path = NULL;
+    golden_t *golden = NULL;
+    double tolerance = 2;
+    uint32_t max_ms = 600 * 1000, abort_ms = 0;
+    unsigned count = LE16(script_index), n;
+    trace_t t;
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "qc:t:l:m:a:h")) != -1) {
+        switch (opt) {
+            case 'q': quiet = 1; break;
+            case 'c': golden_path = optarg; break;
+            case 't': tolerance = strtod(optarg, NULL); break;
+            case 'l': echo_lag = strtoul(optarg, NULL, 0); break;
+            case 'm': max_ms = strtoul(optarg, NULL, 0) * 1000; break;
+            case 'a': abort_ms = strtoul(optarg, NULL, 0); break;
+            default: usage(argv[0]);
+        }
+    }
+
+    typed_init();
+    trigger_init();
+    payload_init();
+    if (golden_path != NULL)
+        golden = golden_read(golden_path, count);
+
+    for (n = 0; n < count; ++n) {
+        if (!quiet)
+            printf("payload %u\n", n);
+
+        if (!run(n, &t, max_ms, abort_ms)) {
+            fprintf(stderr, "payload %u: still running after %u ms\n", n, max_ms);
+            failed = 1;
+        }
+
+        printf("payload %u text \"%s\"\n", n, t.text);
+        printf("payload %u reports %u chars %u runtime_ms %u chars_per_s %.2f\n",
+               n, t.reports, t.chars, t.runtime, chars_per_s(&t));
+        if (t.aborted)
+            printf("payload %u aborted_ms %u silent_after_ms %u\n",
+                   n, t.aborted, t.silent - t.aborted);
+
+        if (golden != NULL && regressed(n, &t, &golden[n], tolerance))
+            failed = 1;
+        free(t.text);
+    }
+
+    return failed;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Compares trigger_match against the memcmp loop it replaced, for growing
+// numbers of trigger UUIDs. Both must agree on every packet.
+
+#include "ble.h"
+#include "trigger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PACKETS     200000
+#define ROUNDS      5
+
+static uint8_t uuids[TRIGGER_MAX][16];
+static unsigned uuid_count;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state >> 32;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the matcher before trigger_match, one memcmp per offset per trigger
+static int magic_present(uint8_t *packet, uint8_t *magic) {
+    unsigned i;
+
+    for (i = 0; i <= BLE_PACKET_SIZE - 16; ++i)
+        if (memcmp(packet + i, magic, 16) == 0)
+            return 1;
+
+    return 0;
+}
+
+static int reference_match(uint8_t *packet) {
+    unsigned t;
+    for (t = 0; t < uuid_count; ++t)
+        if (magic_present(packet, uuids[t]))
+            return t;
+    return -1;
+}
+
+// packets with a 1 in 8 chance of carrying one of the triggers, at any
+// offset, and otherwise random data that shares a prefix with one
+static void make_packets(uint8_t *pkts) {
+    unsigned i, j;
+    for (i = 0; i < PACKETS; ++i) {
+        uint8_t *p = pkts + i * BLE_PACKET_SIZE;
+        unsigned off = rng() % (BLE_PACKET_SIZE - 16 + 1);
+        for (j = 0; j < BLE_PACKET_SIZE; ++j)
+            p[j] = rng();
+        if (rng() % 8 == 0)
+            memcpy(p + off, uuids[rng() % uuid_count], 16);
+        else
+            memcpy(p + off, uuids[rng() % uuid_count], 1 + rng() % 15);
+    }
+}
+
+int main(void) {
+    static const unsigned sizes[] = { 5, 8, 16, 32, 63 };
+    uint8_t *pkts = malloc(PACKETS * BLE_PACKET_SIZE);
+    volatile int sink = 0;
+    unsigned s, i, r;
+
+    printf("%8s %14s %14s %8s\n", "triggers", "memcmp ns/pkt", "hashed ns/pkt", "speedup");
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        double t0, ref_ns = 1e99, new_ns = 1e99;
+
+        if (sizes[s] > TRIGGER_MAX)
+            break;
+
+        // built in triggers first, as trigger_init registers them
+        trigger_init();
+        memcpy(uuids[0], bootloader_magic, 16);
+        memcpy(uuids[1], abort_magic, 16);
+        memcpy(uuids[2], pause_magic, 16);
+        memcpy(uuids[3], resume_magic, 16);
+        memcpy(uuids[4], ble_magic, 16);
+        trigger_add(ble_magic, TRIGGER_SCRIPT, 0);
+        for (uuid_count = 5; uuid_count < sizes[s]; ++uuid_count) {
+            for (i = 0; i < 16; ++i)
+                uuids[uuid_count][i] = rng();
+            trigger_add(uuids[uuid_count], TRIGGER_SCRIPT, uuid_count);
+        }
+
+        make_packets(pkts);
+
+        for (i = 0; i < PACKETS; ++i) {
+            uint8_t *p = pkts + i * BLE_PACKET_SIZE;
+            if (trigger_match(p) != reference_match(p)) {
+                fprintf(stderr, "mismatch on packet %u with %u triggers\n", i, uuid_count);
+                return 1;
+            }
+        }
+
+        // best of several rounds
+        for (r = 0; r < ROUNDS; ++r) {
+            t0 = now_ns();
+            for (i = 0; i < PACKETS; ++i)
+                sink += reference_match(pkts + i * BLE_PACKET_SIZE);
+            t0 = now_ns() - t0;
+            if (t0 < ref_ns)
+                ref_ns = t0;
+
+            t0 = now_ns();
+            for (i = 0; i < PACKETS; ++i)
+                sink += trigger_match(pkts + i * BLE_PACKET_SIZE);
+            t0 = now_ns() - t0;
+            if (t0 < new_ns)
+                new_ns = t0;
+        }
+
+        printf("%8u %14.1f %14.1f %7.1fx\n", uuid_count,
+               ref_ns / PACKETS, new_ns / PACKETS, ref_ns / new_ns);
+    }
+
+    return 0;
+}
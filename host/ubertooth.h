@@ -0,0 +1,103 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Stand-in for the Ubertooth firmware's ubertooth.h, just enough of it to
+// build the radio, trigger and script code on a Linux host. CC2400 access
+// goes to the mock in cc2400_mock.c.
+
+#ifndef __HOST_UBERTOOTH_H__
+#define __HOST_UBERTOOTH_H__
+
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+// LPC17xx registers, plain variables owned by cc2400_mock.c
+extern volatile u32 T0TC, T0PC;
+extern volatile u32 FIO2PIN, IO2IntEnF, IO2IntStatF, IO2IntClr;
+extern volatile u32 ISER0, ICER0;
+extern volatile u32 IPR[9];  // the NVIC priority bytes of IRQs 0 to 35
+extern volatile u32 T0TCR, T0PR, T0MCR, T0IR, T0MR0, T0MR1, T0MR2;
+
+#define IPR0 IPR[0]
+
+#define ISER0_ISE_TIMER0 (1 << 1)
+#define ICER0_ICE_TIMER0 (1 << 1)
+#define ISER0_ISE_EINT3 (1 << 21)
+#define ICER0_ICE_EINT3 (1 << 21)
+#define ISER0_ISE_USB   (1 << 24)
+#define ICER0_ICE_USB   (1 << 24)
+
+#define TCR_Counter_Enable  (1 << 0)
+#define TCR_Counter_Reset   (1 << 1)
+
+#define TMCR_MR0I (1 << 0)
+#define TMCR_MR1I (1 << 3)
+#define TMCR_MR2I (1 << 6)
+
+// T0IR is write 1 to clear on the LPC17xx but a plain variable here, so
+// raise one match at a time
+#define TIR_MR0_Interrupt (1 << 0)
+#define TIR_MR1_Interrupt (1 << 1)
+#define TIR_MR2_Interrupt (1 << 2)
+
+// board
+#define RXLED_SET do { } while (0)
+#define RXLED_CLR do { } while (0)
+#define TXLED_SET do { } while (0)
+#define TXLED_CLR do { } while (0)
+
+#define WFE() do { } while (0)
+
+#define DFU_MODE 0x4305bb21
+extern volatile u32 bootloader_ctrl;
+
+void ubertooth_init(void);
+void reset(void);
+
+// CC2400 GIO6 on P2.2
+#define PIN_GIO6 (1 << 2)
+
+// CC2400 registers
+#define MANAND   0x0d
+#define FSDIV    0x02
+#define MDMCTRL  0x03
+#define IOCFG    0x08
+#define LMTST    0x12
+#define MDMTST0  0x14
+#define GRMDM    0x20
+#define FSMSTATE 0x27
+#define SYNCL    0x2c
+#define SYNCH    0x2d
+#define FIFOREG  0x70
+
+// CC2400 command strobes
+#define SFSON    0x61
+#define SRX      0x62
+#define SRFOFF   0x64
+
+// CC2400 status bits
+#define XOSC16M_STABLE (1 << 6)
+#define FS_LOCK        (1 << 2)
+
+// CC2400 FSM states
+#define STATE_STROBE_FS_ON 15
+#define STATE_STROBE_RX    16
+
+u32 rbit(u32 value);
+
+void cc2400_set(u8 reg, u16 val);
+u16 cc2400_get(u8 reg);
+u8 cc2400_get8(u8 reg);
+u8 cc2400_status(void);
+u8 cc2400_strobe(u8 reg);
+
+void EINT3_IRQHandler(void);
+
+#endif /* __HOST_UBERTOOTH_H__ */
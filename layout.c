@@ -0,0 +1,18 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// the keyboard layout chosen at build time, HID_LAYOUT_H names its header
+// in layouts/, see LAYOUT in the Makefile
+
+#include <stdint.h>
+
+#ifndef HID_LAYOUT_H
+#error "HID_LAYOUT_H must name a header in layouts/, the Makefile sets it from LAYOUT"
+#endif
+#include HID_LAYOUT_H
+
+const uint8_t hid_layout[256][2] = HID_LAYOUT;
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+
+# Copyright 2019 Mike Ryan
+#
+# This file is part of Uberducky and is released under the terms of the
+# GPL version 2. Refer to COPYING for more information.
+
+# Keyboard layouts. Maps each character a layout can type to the HID usage
+# of the key and the modifiers held with it. Run as a script, this outputs
+# the lookup table for a layout as a C header to stdout, the layout name is
+# given as a command line argument. The headers are kept in layouts/ so the
+# firmware builds without Python, make tables regenerates them.
+#
+# Scripts are Latin-1, so a layout covers the Latin-1 characters its keys
+# type, written as escapes so this file stays ASCII. Characters that need a
+# dead key (e.g. ` and ^ on a German keyboard, or capital accented letters
+# on a French one) or are outside Latin-1 (e.g. the euro sign) are left
+# out, so script_gen.py rejects them.
+
+from __future__ import print_function
+
+import sys
+
+NONE = 0x00
+SHIFT = 0x02
+ALTGR = 0x40 # right alt
+
+# builds a layout from (modifiers, chars, first HID usage) runs, where the
+# chars are on consecutive usages
+def build(*runs):
+    layout = {}
+    for mod, chars, usage in runs:
+        for i, c in enumerate(chars):
+            layout[c] = (usage + i, mod)
+    return layout
+
+# keys that are the same on every layout
+common = [
+    (NONE, '\n', 0x28),
+    (NONE, '\t', 0x2b),
+    (NONE, ' ', 0x2c),
+]
+
+us = build(*common + [
+    (NONE,  'abcdefghijklmnopqrstuvwxyz', 0x04),
+    (SHIFT, 'ABCDEFGHIJKLMNOPQRSTUVWXYZ', 0x04),
+    (NONE,  '1234567890', 0x1e),
+    (SHIFT, '!@#$%^&*()', 0x1e),
+    (NONE,  '-=[]\\', 0x2d),
+    (SHIFT, '_+{}|', 0x2d),
+    (NONE,  ';\'`,./', 0x33),
+    (SHIFT, ':"~<>?', 0x33),
+])
+
+uk = build(*common + [
+    (NONE,  'abcdefghijklmnopqrstuvwxyz', 0x04),
+    (SHIFT, 'ABCDEFGHIJKLMNOPQRSTUVWXYZ', 0x04),
+    (NONE,  '1234567890', 0x1e),
+    (SHIFT, '!"', 0x1e),
+    (SHIFT, '$%^&*()', 0x21),
+    (NONE,  '-=[]', 0x2d),
+    (SHIFT, '_+{}', 0x2d),
+    (NONE,  '#', 0x32),
+    (SHIFT, '~', 0x32),
+    (NONE,  ';\'`,./', 0x33),
+    (SHIFT, ':@', 0x33),
+    (SHIFT, '<>?', 0x36),
+    (NONE,  '\\', 0x64),
+    (SHIFT, '|', 0x64),
+])
+
+de = build(*common + [
+    (NONE,  'abcdefghijklmnopqrstuvwxzy', 0x04),
+    (SHIFT, 'ABCDEFGHIJKLMNOPQRSTUVWXZY', 0x04),
+    (NONE,  '1234567890', 0x1e),
+    (SHIFT, '!"', 0x1e),
+    (SHIFT, '$%&/()=', 0x21),
+    (SHIFT, '?', 0x2d),
+    (NONE,  '+', 0x30),
+    (SHIFT, '*', 0x30),
+    (NONE,  '#', 0x32),
+    (SHIFT, '\'', 0x32),
+    (NONE,  ',.-', 0x36),
+    (SHIFT, ';:_', 0x36),
+    (NONE,  '<', 0x64),
+    (SHIFT, '>', 0x64),
+    (ALTGR, '@', 0x14),
+    (ALTGR, '{[]}', 0x24),
+    (ALTGR, '\\', 0x2d),
+    (ALTGR, '~', 0x30),
+    (ALTGR, '|', 0x64),
+    (SHIFT, u'\xa7', 0x20),         # section sign
+    (NONE,  u'\xdf', 0x2d),         # sharp s
+    (NONE,  u'\xfc', 0x2f),         # u umlaut
+    (SHIFT, u'\xdc', 0x2f),
+    (NONE,  u'\xf6\xe4', 0x33),     # o and a umlaut
+    (SHIFT, u'\xd6\xc4', 0x33),
+    (SHIFT, u'\xb0', 0x35),         # degree sign
+    (ALTGR, u'\xb2\xb3', 0x1f),     # superscript 2 and 3
+    (ALTGR, u'\xb5', 0x10),         # micro sign
+])
+
+fr = build(*common + [
+    (NONE,  'qbcdefghijkl', 0x04),
+    (SHIFT, 'QBCDEFGHIJKL', 0x04),
+    (NONE,  ',nopar', 0x10),
+    (SHIFT, '?NOPAR', 0x10),
+    (NONE,  'stuvzxyw', 0x16),
+    (SHIFT, 'STUVZXYW', 0x16),
+    (NONE,  'm', 0x33),
+    (SHIFT, 'M', 0x33),
+    (NONE,  '&', 0x1e),
+    (NONE,  '"\'(-', 0x20),
+    (NONE,  '_', 0x25),
+    (SHIFT, '1234567890', 0x1e),
+    (NONE,  ')=', 0x2d),
+    (SHIFT, '+', 0x2e),
+    (NONE,  '$', 0x30),
+    (NONE,  '*', 0x32),
+    (SHIFT, '%', 0x34),
+    (NONE,  ';:!', 0x36),
+    (SHIFT, './', 0x36),
+    (NONE,  '<', 0x64),
+    (SHIFT, '>', 0x64),
+    (ALTGR, '#{[|', 0x20),
+    (ALTGR, '\\^@', 0x25),
+    (ALTGR, ']}', 0x2d),
+    (NONE,  u'\xe9', 0x1f),         # e acute
+    (NONE,  u'\xe8', 0x24),         # e grave
+    (NONE,  u'\xe7\xe0', 0x26),     # c cedilla, a grave
+    (SHIFT, u'\xb0', 0x2d),         # degree sign
+    (SHIFT, u'\xa3', 0x30),         # pound sign
+    (ALTGR, u'\xa4', 0x30),         # currency sign
+    (SHIFT, u'\xb5', 0x32),         # micro sign
+    (NONE,  u'\xf9', 0x34),         # u grave
+    (NONE,  u'\xb2', 0x35),         # superscript 2
+    (SHIFT, u'\xa7', 0x38),         # section sign
+])
+
+layouts = {
+    'us': us,
+    'uk': uk,
+    'de': de,
+    'fr': fr,
+}
+
+def get_layout(name):
+    try:
+        return layouts[name]
+    except KeyError:
+        raise Exception("Unknown keyboard layout '%s', choose from %s" %
+                        (name, ', '.join(sorted(layouts))))
+
+def layout_to_header(name):
+    layout = get_layout(name)
+    table = [(0, 0)] * 256
+    for c, entry in layout.items():
+        table[ord(c)] = entry
+
+    print('// generated by layout_gen.py for the \'%s\' keyboard layout, make tables' % name)
+    print('// regenerates it')
+    print('// HID usage and modifiers of each character, usage 0 if the layout')
+    print('// has no key for it, the initializer of hid_layout in layout.c')
+    print('#define HID_LAYOUT { \\')
+    for i, (usage, mod) in enumerate(table):
+        if 0x20 < i < 0x7f:
+            comment = ' /* %s */' % chr(i)
+        else:
+            comment = ' /* 0x%02x */' % i
+        print('    { 0x%02x, 0x%02x },%s \\' % (usage, mod, comment))
+    print('}')
+
+if __name__ == "__main__":
+    try:
+        name = sys.argv[1]
+    except IndexError:
+        print("Usage: %s <layout>" % sys.argv[0])
+        exit(1)
+
+    try:
+        layout_to_header(name)
+    except Exception as e:
+        print("Problem generating keyboard layout: %s" % e)
+        sys.exit(1)
@@ -0,0 +1,262 @@
+// generated by layout_gen.py for the 'uk' keyboard layout, make tables
+// regenerates it
+// HID usage and modifiers of each character, usage 0 if the layout
+// has no key for it, the initializer of hid_layout in layout.c
+#define HID_LAYOUT { \
+    { 0x00, 0x00 }, /* 0x00 */ \
+    { 0x00, 0x00 }, /* 0x01 */ \
+    { 0x00, 0x00 }, /* 0x02 */ \
+    { 0x00, 0x00 }, /* 0x03 */ \
+    { 0x00, 0x00 }, /* 0x04 */ \
+    { 0x00, 0x00 }, /* 0x05 */ \
+    { 0x00, 0x00 }, /* 0x06 */ \
+    { 0x00, 0x00 }, /* 0x07 */ \
+    { 0x00, 0x00 }, /* 0x08 */ \
+    { 0x2b, 0x00 }, /* 0x09 */ \
+    { 0x28, 0x00 }, /* 0x0a */ \
+    { 0x00, 0x00 }, /* 0x0b */ \
+    { 0x00, 0x00 }, /* 0x0c */ \
+    { 0x00, 0x00 }, /* 0x0d */ \
+    { 0x00, 0x00 }, /* 0x0e */ \
+    { 0x00, 0x00 }, /* 0x0f */ \
+    { 0x00, 0x00 }, /* 0x10 */ \
+    { 0x00, 0x00 }, /* 0x11 */ \
+    { 0x00, 0x00 }, /* 0x12 */ \
+    { 0x00, 0x00 }, /* 0x13 */ \
+    { 0x00, 0x00 }, /* 0x14 */ \
+    { 0x00, 0x00 }, /* 0x15 */ \
+    { 0x00, 0x00 }, /* 0x16 */ \
+    { 0x00, 0x00 }, /* 0x17 */ \
+    { 0x00, 0x00 }, /* 0x18 */ \
+    { 0x00, 0x00 }, /* 0x19 */ \
+    { 0x00, 0x00 }, /* 0x1a */ \
+    { 0x00, 0x00 }, /* 0x1b */ \
+    { 0x00, 0x00 }, /* 0x1c */ \
+    { 0x00, 0x00 }, /* 0x1d */ \
+    { 0x00, 0x00 }, /* 0x1e */ \
+    { 0x00, 0x00 }, /* 0x1f */ \
+    { 0x2c, 0x00 }, /* 0x20 */ \
+    { 0x1e, 0x02 }, /* ! */ \
+    { 0x1f, 0x02 }, /* " */ \
+    { 0x32, 0x00 }, /* # */ \
+    { 0x21, 0x02 }, /* $ */ \
+    { 0x22, 0x02 }, /* % */ \
+    { 0x24, 0x02 }, /* & */ \
+    { 0x34, 0x00 }, /* ' */ \
+    { 0x26, 0x02 }, /* ( */ \
+    { 0x27, 0x02 }, /* ) */ \
+    { 0x25, 0x02 }, /* * */ \
+    { 0x2e, 0x02 }, /* + */ \
+    { 0x36, 0x00 }, /* , */ \
+    { 0x2d, 0x00 }, /* - */ \
+    { 0x37, 0x00 }, /* . */ \
+    { 0x38, 0x00 }, /* / */ \
+    { 0x27, 0x00 }, /* 0 */ \
+    { 0x1e, 0x00 }, /* 1 */ \
+    { 0x1f, 0x00 }, /* 2 */ \
+    { 0x20, 0x00 }, /* 3 */ \
+    { 0x21, 0x00 }, /* 4 */ \
+    { 0x22, 0x00 }, /* 5 */ \
+    { 0x23, 0x00 }, /* 6 */ \
+    { 0x24, 0x00 }, /* 7 */ \
+    { 0x25, 0x00 }, /* 8 */ \
+    { 0x26, 0x00 }, /* 9 */ \
+    { 0x33, 0x02 }, /* : */ \
+    { 0x33, 0x00 }, /* ; */ \
+    { 0x36, 0x02 }, /* < */ \
+    { 0x2e, 0x00 }, /* = */ \
+    { 0x37, 0x02 }, /* > */ \
+    { 0x38, 0x02 }, /* ? */ \
+    { 0x34, 0x02 }, /* @ */ \
+    { 0x04, 0x02 }, /* A */ \
+    { 0x05, 0x02 }, /* B */ \
+    { 0x06, 0x02 }, /* C */ \
+    { 0x07, 0x02 }, /* D */ \
+    { 0x08, 0x02 }, /* E */ \
+    { 0x09, 0x02 }, /* F */ \
+    { 0x0a, 0x02 }, /* G */ \
+    { 0x0b, 0x02 }, /* H */ \
+    { 0x0c, 0x02 }, /* I */ \
+    { 0x0d, 0x02 }, /* J */ \
+    { 0x0e, 0x02 }, /* K */ \
+    { 0x0f, 0x02 }, /* L */ \
+    { 0x10, 0x02 }, /* M */ \
+    { 0x11, 0x02 }, /* N */ \
+    { 0x12, 0x02 }, /* O */ \
+    { 0x13, 0x02 }, /* P */ \
+    { 0x14, 0x02 }, /* Q */ \
+    { 0x15, 0x02 }, /* R */ \
+    { 0x16, 0x02 }, /* S */ \
+    { 0x17, 0x02 }, /* T */ \
+    { 0x18, 0x02 }, /* U */ \
+    { 0x19, 0x02 }, /* V */ \
+    { 0x1a, 0x02 }, /* W */ \
+    { 0x1b, 0x02 }, /* X */ \
+    { 0x1c, 0x02 }, /* Y */ \
+    { 0x1d, 0x02 }, /* Z */ \
+    { 0x2f, 0x00 }, /* [ */ \
+    { 0x64, 0x00 }, /* \ */ \
+    { 0x30, 0x00 }, /* ] */ \
+    { 0x23, 0x02 }, /* ^ */ \
+    { 0x2d, 0x02 }, /* _ */ \
+    { 0x35, 0x00 }, /* ` */ \
+    { 0x04, 0x00 }, /* a */ \
+    { 0x05, 0x00 }, /* b */ \
+    { 0x06, 0x00 }, /* c */ \
+    { 0x07, 0x00 }, /* d */ \
+    { 0x08, 0x00 }, /* e */ \
+    { 0x09, 0x00 }, /* f */ \
+    { 0x0a, 0x00 }, /* g */ \
+    { 0x0b, 0x00 }, /* h */ \
+    { 0x0c, 0x00 }, /* i */ \
+    { 0x0d, 0x00 }, /* j */ \
+    { 0x0e, 0x00 }, /* k */ \
+    { 0x0f, 0x00 }, /* l */ \
+    { 0x10, 0x00 }, /* m */ \
+    { 0x11, 0x00 }, /* n */ \
+    { 0x12, 0x00 }, /* o */ \
+    { 0x13, 0x00 }, /* p */ \
+    { 0x14, 0x00 }, /* q */ \
+    { 0x15, 0x00 }, /* r */ \
+    { 0x16, 0x00 }, /* s */ \
+    { 0x17, 0x00 }, /* t */ \
+    { 0x18, 0x00 }, /* u */ \
+    { 0x19, 0x00 }, /* v */ \
+    { 0x1a, 0x00 }, /* w */ \
+    { 0x1b, 0x00 }, /* x */ \
+    { 0x1c, 0x00 }, /* y */ \
+    { 0x1d, 0x00 }, /* z */ \
+    { 0x2f, 0x02 }, /* { */ \
+    { 0x64, 0x02 }, /* | */ \
+    { 0x30, 0x02 }, /* } */ \
+    { 0x32, 0x02 }, /* ~ */ \
+    { 0x00, 0x00 }, /* 0x7f */ \
+    { 0x00, 0x00 }, /* 0x80 */ \
+    { 0x00, 0x00 }, /* 0x81 */ \
+    { 0x00, 0x00 }, /* 0x82 */ \
+    { 0x00, 0x00 }, /* 0x83 */ \
+    { 0x00, 0x00 }, /* 0x84 */ \
+    { 0x00, 0x00 }, /* 0x85 */ \
+    { 0x00, 0x00 }, /* 0x86 */ \
+    { 0x00, 0x00 }, /* 0x87 */ \
+    { 0x00, 0x00 }, /* 0x88 */ \
+    { 0x00, 0x00 }, /* 0x89 */ \
+    { 0x00, 0x00 }, /* 0x8a */ \
+    { 0x00, 0x00 }, /* 0x8b */ \
+    { 0x00, 0x00 }, /* 0x8c */ \
+    { 0x00, 0x00 }, /* 0x8d */ \
+    { 0x00, 0x00 }, /* 0x8e */ \
+    { 0x00, 0x00 }, /* 0x8f */ \
+    { 0x00, 0x00 }, /* 0x90 */ \
+    { 0x00, 0x00 }, /* 0x91 */ \
+    { 0x00, 0x00 }, /* 0x92 */ \
+    { 0x00, 0x00 }, /* 0x93 */ \
+    { 0x00, 0x00 }, /* 0x94 */ \
+    { 0x00, 0x00 }, /* 0x95 */ \
+    { 0x00, 0x00 }, /* 0x96 */ \
+    { 0x00, 0x00 }, /* 0x97 */ \
+    { 0x00, 0x00 }, /* 0x98 */ \
+    { 0x00, 0x00 }, /* 0x99 */ \
+    { 0x00, 0x00 }, /* 0x9a */ \
+    { 0x00, 0x00 }, /* 0x9b */ \
+    { 0x00, 0x00 }, /* 0x9c */ \
+    { 0x00, 0x00 }, /* 0x9d */ \
+    { 0x00, 0x00 }, /* 0x9e */ \
+    { 0x00, 0x00 }, /* 0x9f */ \
+    { 0x00, 0x00 }, /* 0xa0 */ \
+    { 0x00, 0x00 }, /* 0xa1 */ \
+    { 0x00, 0x00 }, /* 0xa2 */ \
+    { 0x00, 0x00 }, /* 0xa3 */ \
+    { 0x00, 0x00 }, /* 0xa4 */ \
+    { 0x00, 0x00 }, /* 0xa5 */ \
+    { 0x00, 0x00 }, /* 0xa6 */ \
+    { 0x00, 0x00 }, /* 0xa7 */ \
+    { 0x00, 0x00 }, /* 0xa8 */ \
+    { 0x00, 0x00 }, /* 0xa9 */ \
+    { 0x00, 0x00 }, /* 0xaa */ \
+    { 0x00, 0x00 }, /* 0xab */ \
+    { 0x00, 0x00 }, /* 0xac */ \
+    { 0x00, 0x00 }, /* 0xad */ \
+    { 0x00, 0x00 }, /* 0xae */ \
+    { 0x00, 0x00 }, /* 0xaf */ \
+    { 0x00, 0x00 }, /* 0xb0 */ \
+    { 0x00, 0x00 }, /* 0xb1 */ \
+    { 0x00, 0x00 }, /* 0xb2 */ \
+    { 0x00, 0x00 }, /* 0xb3 */ \
+    { 0x00, 0x00 }, /* 0xb4 */ \
+    { 0x00, 0x00 }, /* 0xb5 */ \
+    { 0x00, 0x00 }, /* 0xb6 */ \
+    { 0x00, 0x00 }, /* 0xb7 */ \
+    { 0x00, 0x00 }, /* 0xb8 */ \
+    { 0x00, 0x00 }, /* 0xb9 */ \
+    { 0x00, 0x00 }, /* 0xba */ \
+    { 0x00, 0x00 }, /* 0xbb */ \
+    { 0x00, 0x00 }, /* 0xbc */ \
+    { 0x00, 0x00 }, /* 0xbd */ \
+    { 0x00, 0x00 }, /* 0xbe */ \
+    { 0x00, 0x00 }, /* 0xbf */ \
+    { 0x00, 0x00 }, /* 0xc0 */ \
+    { 0x00, 0x00 }, /* 0xc1 */ \
+    { 0x00, 0x00 }, /* 0xc2 */ \
+    { 0x00, 0x00 }, /* 0xc3 */ \
+    { 0x00, 0x00 }, /* 0xc4 */ \
+    { 0x00, 0x00 }, /* 0xc5 */ \
+    { 0x00, 0x00 }, /* 0xc6 */ \
+    { 0x00, 0x00 }, /* 0xc7 */ \
+    { 0x00, 0x00 }, /* 0xc8 */ \
+    { 0x00, 0x00 }, /* 0xc9 */ \
+    { 0x00, 0x00 }, /* 0xca */ \
+    { 0x00, 0x00 }, /* 0xcb */ \
+    { 0x00, 0x00 }, /* 0xcc */ \
+    { 0x00, 0x00 }, /* 0xcd */ \
+    { 0x00, 0x00 }, /* 0xce */ \
+    { 0x00, 0x00 }, /* 0xcf */ \
+    { 0x00, 0x00 }, /* 0xd0 */ \
+    { 0x00, 0x00 }, /* 0xd1 */ \
+    { 0x00, 0x00 }, /* 0xd2 */ \
+    { 0x00, 0x00 }, /* 0xd3 */ \
+    { 0x00, 0x00 }, /* 0xd4 */ \
+    { 0x00, 0x00 }, /* 0xd5 */ \
+    { 0x00, 0x00 }, /* 0xd6 */ \
+    { 0x00, 0x00 }, /* 0xd7 */ \
+    { 0x00, 0x00 }, /* 0xd8 */ \
+    { 0x00, 0x00 }, /* 0xd9 */ \
+    { 0x00, 0x00 }, /* 0xda */ \
+    { 0x00, 0x00 }, /* 0xdb */ \
+    { 0x00, 0x00 }, /* 0xdc */ \
+    { 0x00, 0x00 }, /* 0xdd */ \
+    { 0x00, 0x00 }, /* 0xde */ \
+    { 0x00, 0x00 }, /* 0xdf */ \
+    { 0x00, 0x00 }, /* 0xe0 */ \
+    { 0x00, 0x00 }, /* 0xe1 */ \
+    { 0x00, 0x00 }, /* 0xe2 */ \
+    { 0x00, 0x00 }, /* 0xe3 */ \
+    { 0x00, 0x00 }, /* 0xe4 */ \
+    { 0x00, 0x00 }, /* 0xe5 */ \
+    { 0x00, 0x00 }, /* 0xe6 */ \
+    { 0x00, 0x00 }, /* 0xe7 */ \
+    { 0x00, 0x00 }, /* 0xe8 */ \
+    { 0x00, 0x00 }, /* 0xe9 */ \
+    { 0x00, 0x00 }, /* 0xea */ \
+    { 0x00, 0x00 }, /* 0xeb */ \
+    { 0x00, 0x00 }, /* 0xec */ \
+    { 0x00, 0x00 }, /* 0xed */ \
+    { 0x00, 0x00 }, /* 0xee */ \
+    { 0x00, 0x00 }, /* 0xef */ \
+    { 0x00, 0x00 }, /* 0xf0 */ \
+    { 0x00, 0x00 }, /* 0xf1 */ \
+    { 0x00, 0x00 }, /* 0xf2 */ \
+    { 0x00, 0x00 }, /* 0xf3 */ \
+    { 0x00, 0x00 }, /* 0xf4 */ \
+    { 0x00, 0x00 }, /* 0xf5 */ \
+    { 0x00, 0x00 }, /* 0xf6 */ \
+    { 0x00, 0x00 }, /* 0xf7 */ \
+    { 0x00, 0x00 }, /* 0xf8 */ \
+    { 0x00, 0x00 }, /* 0xf9 */ \
+    { 0x00, 0x00 }, /* 0xfa */ \
+    { 0x00, 0x00 }, /* 0xfb */ \
+    { 0x00, 0x00 }, /* 0xfc */ \
+    { 0x00, 0x00 }, /* 0xfd */ \
+    { 0x00, 0x00 }, /* 0xfe */ \
+    { 0x00, 0x00 }, /* 0xff */ \
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "ota.h"
+#include "upload.h"
+
+#include <string.h>
+
+// announces an upload
+// random UUID:
+// 7b0e5c1a-3d92-4f6b-a8e4-2c61d09f5b37
+uint8_t ota_magic[16] = {
+    0x37, 0x5b, 0x9f, 0xd0, 0x61, 0x2c, 0xe4, 0xa8,
+    0x6b, 0x4f, 0x92, 0x3d, 0x1a, 0x5c, 0x0e, 0x7b,
+};
+
+uint32_t ota_chunks = 0;
+uint32_t ota_duplicates = 0;
+uint32_t ota_commits = 0;
+uint32_t ota_failures = 0;
+
+#ifndef OTA_KEY
+#error "OTA_UPLOAD needs OTA_KEY, build with make OTA=1 OTA_KEY=..."
+#endif
+
+// uploads are signed with this, see ducky_ota.py --key
+static const uint8_t ota_key[16] = OTA_KEY;
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+#define LE32(p) (LE16(p) | (LE16((p)+2) << 16))
+#define LE64(p) ((uint32_t)LE32(p) | ((uint64_t)(uint32_t)LE32((p)+4) << 32))
+
+// offsets in the packet, after the PDU header and AdvA
+#define OTA_PDU_LEN     27
+#define OTA_AD          8
+#define OTA_UUID        (OTA_AD + 2)
+#define OTA_ANNOUNCE    (OTA_UUID + 16)     // session and chunk count
+#define AD_SERVICE_DATA_128 0x21
+#define OTA_CHUNK       (OTA_AD + 4)        // session, chunk number and data
+
+#define ADV_NONCONN_IND 0x2
+
+#define OTA_MAX_CHUNKS  ((OTA_HEADER_LEN + OTA_MAX_LEN + OTA_CHUNK_DATA - 1) / OTA_CHUNK_DATA)
+
+static uint8_t staging[OTA_MAX_CHUNKS * OTA_CHUNK_DATA];
+static uint32_t have[(OTA_MAX_CHUNKS + 31) / 32];   // chunks received
+
+static int session = -1;        // none after boot
+static unsigned chunk_count = 0;
+static unsigned chunks_left = 0;
+
+#define ROTL(x, b)  (((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPROUND do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+} while (0)
+
+// SipHash-2-4 of len bytes at p under ota_key
+static uint64_t ota_mac(const uint8_t *p, unsigned len) {
+    uint64_t k0 = LE64(ota_key), k1 = LE64(ota_key + 8);
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    uint64_t m;
+    unsigned i, left;
+
+    for (left = len; left >= 8; left -= 8, p += 8) {
+        m = LE64(p);
+        v3 ^= m;
+        SIPROUND; SIPROUND;
+        v0 ^= m;
+    }
+
+    // the last 0 to 7 bytes with the length in the top byte
+    m = (uint64_t)len << 56;
+    for (i = 0; i < left; ++i)
+        m |= (uint64_t)p[i] << (8 * i);
+    v3 ^= m;
+    SIPROUND; SIPROUND;
+    v0 ^= m;
+
+    v2 ^= 0xff;
+    SIPROUND; SIPROUND; SIPROUND; SIPROUND;
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// write the staged image to flash if it is whole and signed with our key
+static int ota_commit(void) {
+    unsigned len = LE16(staging + OTA_MAC_LEN), pos, n;
+    uint32_t crc = LE32(staging + OTA_MAC_LEN + 2);
+    uint8_t *image = staging + OTA_HEADER_LEN;
+
+    if (len == 0 || len > chunk_count * OTA_CHUNK_DATA - OTA_HEADER_LEN)
+        return 0;
+    // nothing touches flash for an image that anyone in range could have sent
+    if (ota_mac(staging + OTA_MAC_LEN, OTA_HEADER_LEN - OTA_MAC_LEN + len) != LE64(staging))
+        return 0;
+    if (upload_crc32(image, len) != crc)
+        return 0;
+
+    if (!upload_start(len))
+        return 0;
+
+    // erasing and programming the page filled last before adding the next
+    // chunk means upload_data only fails if flash does
+    for (pos = 0; pos < len; pos += n) {
+        n = len - pos < UPLOAD_CHUNK ? len - pos : UPLOAD_CHUNK;
+        while (upload_poll())
+            ;
+        if (!upload_data(pos / UPLOAD_CHUNK, image + pos, n))
+            return 0;
+    }
+
+    return upload_end(crc);
+}
+
+static void ota_announce(const uint8_t *p) {
+    unsigned count = LE16(p + 1);
+
+    // repeated announcements of the current session
+    if (p[0] == session || count == 0 || count > OTA_MAX_CHUNKS)
+        return;
+
+    session = p[0];
+    chunk_count = chunks_left = count;
+    memset(have, 0, sizeof(have));
+}
+
+static void ota_chunk(const uint8_t *p) {
+    unsigned n = LE16(p + 1);
+
+    if (p[0] != session || chunks_left == 0 || n >= chunk_count)
+        return;
+
+    if (have[n / 32] & (1u << (n % 32))) {
+        ++ota_duplicates;
+        return;
+    }
+    have[n / 32] |= 1u << (n % 32);
+    memcpy(staging + n * OTA_CHUNK_DATA, p + 3, OTA_CHUNK_DATA);
+    ++ota_chunks;
+
+    if (--chunks_left == 0) {
+        if (ota_commit())
+            ++ota_commits;
+        else
+            ++ota_failures;
+    }
+}
+
+// take an announcement or chunk out of a valid advertisement, anything else
+// is ignored
+void ota_packet(const uint8_t *packet) {
+    const uint8_t *ad = packet + OTA_AD;
+
+    if ((packet[0] & 0x0f) != ADV_NONCONN_IND || packet[1] != OTA_PDU_LEN)
+        return;
+
+    if (ad[0] == 20 && ad[1] == AD_SERVICE_DATA_128 && memcmp(packet + OTA_UUID, ota_magic, 16) == 0)
+        ota_announce(packet + OTA_ANNOUNCE);
+    else if (ad[0] == 20 && ad[1] == 0xff && ad[2] == 0xff && ad[3] == 0xff)
+        ota_chunk(packet + OTA_CHUNK);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __OTA_H__
+#define __OTA_H__
+
+#include <stdint.h>
+
+// Payload upload over the air, see ducky_ota.py
+//
+// An upload is announced by advertisements carrying the upload UUID, then
+// sent as numbered chunks that may arrive in any order and any number of
+// times. Both are ADV_NONCONN_IND with 27 bytes of payload, short enough
+// for ble_valid to check their CRC:
+//
+//  announce    AdvA | 20 0x21 upload UUID | session | chunk count (16 bit)
+//  chunk       AdvA | 20 0xff 0xffff      | session | chunk number (16 bit) | data
+//
+// The announcement is service data for the upload UUID. The chunk data is a
+// SipHash-2-4 MAC (64 bit) under the OTA_KEY the firmware was built with,
+// the image length (16 bit) and CRC-32 (32 bit), then the output of
+// script_gen.py --image. The MAC covers everything after it. Once every
+// chunk is in and the MAC and CRC match, the image is written to flash as a
+// USB upload would be.
+
+#define OTA_CHUNK_DATA  14      // bytes of data per chunk
+#define OTA_HEADER_LEN  14      // MAC, image length and CRC
+#define OTA_MAC_LEN     8
+
+// largest image, it is staged in RAM
+#ifndef OTA_MAX_LEN
+#define OTA_MAX_LEN     2048
+#endif
+
+extern uint8_t ota_magic[16];
+
+extern uint32_t ota_chunks;         // chunks received
+extern uint32_t ota_duplicates;     // chunks received again
+extern uint32_t ota_commits;        // images written to flash
+extern uint32_t ota_failures;       // images failing the MAC, the CRC or the write
+
+void ota_packet(const uint8_t *packet);
+
+#endif /* __OTA_H__ */
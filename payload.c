@@ -0,0 +1,185 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "payload.h"
+#include "trigger.h"
+
+#ifdef SCRIPT_UPLOAD
+#include "upload.h"
+#endif
+
+#include <string.h>
+
+// auto-generated from duckyscript input, see build_index in script_gen.py
+// for the format of the index
+extern const uint8_t script[];
+extern const uint8_t script_index[];
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+#define LE32(p) (LE16(p) | (LE16((p)+2) << 16))
+
+#define INDEX_ENTRY(n)  (payload_index + 2 + (n) * 20)
+
+// the built in payloads, or an uploaded image of the same layout: the index
+// followed by the payloads
+static const uint8_t *payload_index = script_index;
+static const uint8_t *payloads = script;
+
+// start of the selected payload
+static const uint8_t *payload = script;
+
+// a script is reading the selected payload
+static int in_use = 0;
+
+uint32_t payload_untriggered = 0;
+
+// use the payloads of index and register the trigger of every one, the
+// trigger argument is the payload's index so it can be selected without a
+// search
+static void payload_use(const uint8_t *index, const uint8_t *data) {
+    static const uint8_t default_trigger[16] = { 0, };
+    unsigned i, count;
+
+    payload_index = index;
+    payloads = data;
+    payload_untriggered = 0;
+
+    // script_gen.py keeps to PAYLOAD_MAX, but count any that don't fit
+    // rather than lose them without a trace
+    count = LE16(payload_index);
+    for (i = 0; i < count; ++i) {
+        const uint8_t *uuid = INDEX_ENTRY(i);
+        if (memcmp(uuid, default_trigger, 16) == 0)
+            uuid = ble_magic;
+        if (trigger_add(uuid, TRIGGER_SCRIPT, i) < 0)
+            ++payload_untriggered;
+    }
+}
+
+// the uploaded image if there is a complete one, otherwise the built in
+// payloads
+void payload_init(void) {
+#ifdef SCRIPT_UPLOAD
+    const uint8_t *image = upload_image();
+
+    if (image != NULL) {
+        payload_use(image, image + 2 + LE16(image) * 20);
+        return;
+    }
+#endif
+    payload_use(script_index, script);
+}
+
+// the built in payloads even if there is an uploaded image, for while it
+// is being replaced
+void payload_init_builtin(void) {
+    payload_use(script_index, script);
+}
+
+// choose the payload the next payload_open reads
+void payload_select(unsigned n) {
+    payload = payloads + LE32(INDEX_ENTRY(n) + 16);
+    in_use = 1;
+}
+
+// the script reading the selected payload has finished
+void payload_close(void) {
+    in_use = 0;
+}
+
+int payload_in_use(void) {
+    return in_use;
+}
+
+#ifdef COMPRESSED_SCRIPT
+
+// compressed format, all little endian:
+//
+//  length      uncompressed bytecode length (32 bit)
+//  offsets     offset of each block from the end of this table (32 bit each)
+//  blocks      PAYLOAD_BLOCK_SIZE bytes of bytecode each, LZSS compressed
+//
+// LZSS: a flag byte precedes every 8 items, LSB first. A set bit is a
+// literal byte, a clear bit is a 16 bit match: 12 bits of distance - 1 and
+// 4 bits of length - 3, copied from earlier in the same block. Blocks are
+// independent so any position can be reached by decompressing one block.
+
+static unsigned payload_len = 0;
+static const uint8_t *block_table;
+static const uint8_t *block_data;
+
+// the one block held in RAM
+static uint8_t block_buf[PAYLOAD_BLOCK_SIZE];
+static int cur_block = -1;
+
+static void block_load(unsigned block) {
+    const uint8_t *in = block_data + LE32(block_table + block * 4);
+    unsigned out = 0, end = payload_len - block * PAYLOAD_BLOCK_SIZE;
+    unsigned flags = 0, dist, len;
+
+    if (end > PAYLOAD_BLOCK_SIZE)
+        end = PAYLOAD_BLOCK_SIZE;
+
+    while (out < end) {
+        // bit 8 marks when the flag byte is used up
+        if ((flags & 0x100) == 0)
+            flags = *in++ | 0xff00;
+
+        if (flags & 1) {
+            block_buf[out++] = *in++;
+        } else {
+            dist = (LE16(in) & 0xfff) + 1;
+            len = (LE16(in) >> 12) + 3;
+            in += 2;
+            while (len-- && out < end) {
+                block_buf[out] = block_buf[out - dist];
+                ++out;
+            }
+        }
+        flags >>= 1;
+    }
+
+    cur_block = block;
+}
+
+// prepare the script for reading, returns its length
+unsigned payload_open(void) {
+    payload_len = LE32(payload);
+    block_table = payload + 4;
+    block_data = block_table +
+        4 * ((payload_len + PAYLOAD_BLOCK_SIZE - 1) / PAYLOAD_BLOCK_SIZE);
+    cur_block = -1;
+    return payload_len;
+}
+
+// read a byte of bytecode, decompressing at most one block
+uint8_t payload_byte(unsigned pos) {
+    unsigned block = pos / PAYLOAD_BLOCK_SIZE;
+    if ((int)block != cur_block)
+        block_load(block);
+    return block_buf[pos % PAYLOAD_BLOCK_SIZE];
+}
+
+#else
+
+// uncompressed format: 16 bit little endian length followed by bytecode
+
+// prepare the script for reading, returns its length
+unsigned payload_open(void) {
+    return LE16(payload);
+}
+
+uint8_t payload_byte(unsigned pos) {
+    return payload[2 + pos];
+}
+
+#endif
+
+// read a 16 bit little endian argument
+uint16_t payload_word(unsigned pos) {
+    return payload_byte(pos) | (payload_byte(pos + 1) << 8);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __PAYLOAD_H__
+#define __PAYLOAD_H__
+
+#include <stdint.h>
+
+#include "trigger.h"
+
+// most payloads, one for each trigger left after the built in ones,
+// PAYLOAD_MAX in script_gen.py must match
+#define PAYLOAD_MAX (TRIGGER_MAX - TRIGGER_BUILTIN)
+
+// payloads whose trigger couldn't be registered, so they never run
+extern uint32_t payload_untriggered;
+
+// bytes of bytecode per compressed block, must match script_gen.py
+#define PAYLOAD_BLOCK_SIZE 512
+
+void payload_init(void);
+void payload_init_builtin(void);
+void payload_select(unsigned n);
+void payload_close(void);
+int payload_in_use(void);
+unsigned payload_open(void);
+uint8_t payload_byte(unsigned pos);
+uint16_t payload_word(unsigned pos);
+
+#endif /* __PAYLOAD_H__ */
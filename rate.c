@@ -0,0 +1,163 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "rate.h"
+#include "usb.h"
+
+#include <string.h>
+
+// Adaptive typing rate
+//
+// Every RATE_PROBE_EVERY reports, between keys, the player presses a lock
+// key and waits for the host to set the keyboard LEDs to match, then
+// presses it again to put it back. How long the host takes to echo the
+// press shows how far behind it is with the keys already sent. The time
+// each report is held is halved after every good probe until the first bad
+// one, then shortened by 1 ms after a good probe and doubled after a bad
+// one. A host that never echoes keeps the starting rate.
+//
+// Everything here runs in TIMER0_IRQHandler, usb_leds is set by SET_REPORT.
+
+#define PROBE_IDLE      0
+#define PROBE_PRESS     1
+#define PROBE_RELEASE   2
+#define PROBE_ECHO      3
+
+volatile uint32_t rate_down_time = RATE_START_MS;
+volatile uint32_t rate_lag = 0;
+volatile uint32_t rate_probes = 0;
+volatile uint32_t rate_timeouts = 0;
+
+static int state = PROBE_IDLE;
+static unsigned reports = 0;    // script reports since the last probe
+static int keys_up = 1;         // the last script report held no keys
+static int enabled = 1;         // the host echoes probes
+static int echoed = 0;          // ... and has at least once
+static int slow_start = 1;
+
+// the current probe
+static unsigned toggles = 0;
+static uint8_t leds_before = 0;
+static uint32_t pressed = 0;
+static uint32_t lag = 0;
+static int timed_out = 0;
+
+// prepare for a new script, the first probe comes before its first report
+void rate_start(void) {
+    rate_down_time = RATE_START_MS;
+    state = PROBE_IDLE;
+    reports = RATE_PROBE_EVERY;
+    keys_up = 1;
+    enabled = 1;
+    echoed = 0;
+    slow_start = 1;
+}
+
+// the script carries on after a pause, which mustn't count against the
+// echo of a probe in flight
+void rate_resume(uint32_t now) {
+    if (state == PROBE_RELEASE || state == PROBE_ECHO)
+        pressed = now;
+}
+
+static void rate_adjust(void) {
+    ++rate_probes;
+    rate_lag = lag;
+
+    if (timed_out) {
+        ++rate_timeouts;
+        // lock keys aren't echoed by this host, stay at the starting rate
+        if (!echoed) {
+            enabled = 0;
+            rate_down_time = RATE_START_MS;
+            return;
+        }
+    }
+
+    if (timed_out || lag > RATE_LAG_MS) {
+        slow_start = 0;
+        rate_down_time *= 2;
+        if (rate_down_time > RATE_MAX_MS)
+            rate_down_time = RATE_MAX_MS;
+    } else if (slow_start) {
+        rate_down_time /= 2;
+        if (rate_down_time < RATE_MIN_MS)
+            rate_down_time = RATE_MIN_MS;
+    } else if (lag <= RATE_LAG_MS / 2 && rate_down_time > RATE_MIN_MS) {
+        --rate_down_time;
+    }
+}
+
+// whether the player should send a probe report before the script's next
+// report, report is filled in on RATE_SEND
+int rate_probe(uint32_t now, uint8_t *report) {
+    memset(report, 0, 8);
+
+    switch (state) {
+        case PROBE_IDLE:
+            if (!enabled || reports < RATE_PROBE_EVERY || !keys_up)
+                return RATE_NONE;
+            toggles = 0;
+            lag = 0;
+            timed_out = 0;
+            state = PROBE_PRESS;
+            // fall through
+
+        case PROBE_PRESS:
+            report[2] = RATE_PROBE_KEY;
+            return RATE_SEND;
+
+        // all keys up
+        case PROBE_RELEASE:
+            return RATE_SEND;
+
+        case PROBE_ECHO:
+            if ((usb_leds ^ leds_before) & RATE_PROBE_LED) {
+                echoed = 1;
+                if (now - pressed > lag)
+                    lag = now - pressed;
+            } else if (now - pressed >= RATE_TIMEOUT_MS) {
+                timed_out = 1;
+            } else {
+                return RATE_WAIT;
+            }
+
+            // press again to leave the lock as the script found it
+            if (++toggles < 2) {
+                state = PROBE_PRESS;
+                report[2] = RATE_PROBE_KEY;
+                return RATE_SEND;
+            }
+
+            rate_adjust();
+            state = PROBE_IDLE;
+            reports = 0;
+            return RATE_NONE;
+    }
+
+    return RATE_NONE;
+}
+
+// every report the player gets into the queue, probe or script
+void rate_sent(uint32_t now, const uint8_t *report) {
+    switch (state) {
+        case PROBE_PRESS:
+            leds_before = usb_leds;
+            pressed = now;
+            state = PROBE_RELEASE;
+            break;
+
+        case PROBE_RELEASE:
+            state = PROBE_ECHO;
+            break;
+
+        default:
+            ++reports;
+            keys_up = report[0] == 0 && report[2] == 0;
+            break;
+    }
+}
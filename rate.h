@@ -0,0 +1,51 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __RATE_H__
+#define __RATE_H__
+
+#include <stdint.h>
+
+// ms each report is held at the start of a script, and the limits
+#define RATE_START_MS       10
+#define RATE_MIN_MS         1
+#define RATE_MAX_MS         32
+
+// script reports between probes of the host
+#define RATE_PROBE_EVERY    32
+
+// echo lag in ms above which the host is falling behind, and how long to
+// wait for an echo at all
+#define RATE_LAG_MS         20
+#define RATE_TIMEOUT_MS     100
+
+// lock key pressed to probe the host and the LED it toggles, Num Lock by
+// default since it doesn't change what the script types
+#ifdef RATE_CAPS_LOCK
+#define RATE_PROBE_KEY      0x39
+#define RATE_PROBE_LED      0x02
+#else
+#define RATE_PROBE_KEY      0x53
+#define RATE_PROBE_LED      0x01
+#endif
+
+// rate_probe results
+#define RATE_NONE   0   // carry on with the script
+#define RATE_SEND   1   // queue the probe report
+#define RATE_WAIT   2   // waiting for the echo, call again in 1 ms
+
+extern volatile uint32_t rate_down_time;    // ms each report is held
+extern volatile uint32_t rate_lag;          // ms, echo lag of the last probe
+extern volatile uint32_t rate_probes;
+extern volatile uint32_t rate_timeouts;     // probes the host didn't echo
+
+void rate_start(void);
+void rate_resume(uint32_t now);
+int rate_probe(uint32_t now, uint8_t *report);
+void rate_sent(uint32_t now, const uint8_t *report);
+
+#endif /* __RATE_H__ */
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// Reports are written to the interrupt endpoint one at a time. Every time
+// the host picks one up, the endpoint interrupt hands it the next.
+//
+// With HIGH_RATE the host polls every frame, and the next report is instead
+// written on start-of-frame so that reports go out in step with the bus
+// frame clock.
+//
+// To pause or abort a script, an all keys up report can be put ahead of the
+// queue and the queue held back or dropped. The host gets it straight after
+// the report already in the endpoint, so within one report interval.
+
+#include "report_queue.h"
+#include "usb.h"
+
+#include <string.h>
+
+// reports waiting for the host to poll the endpoint
+static uint8_t report_queue[REPORT_QUEUE_LEN][REPORT_SIZE];
+static volatile unsigned queue_head = 0;    // next free slot
+static volatile unsigned queue_tail = 0;    // next report to send
+static volatile int ep_busy = 0;            // report waiting in EP buffer
+static volatile int keys_up = 0;            // all keys up goes before the queue
+static volatile int queue_held = 0;         // see usb_hold_reports
+static const uint8_t all_keys_up[REPORT_SIZE] = { 0, };
+
+volatile uint32_t report_queue_full = 0;
+
+// write the next queued report to the endpoint, or mark it idle
+static void report_queue_send(void) {
+    if (keys_up) {
+        report_queue_write(all_keys_up);
+        keys_up = 0;
+        ep_busy = 1;
+        return;
+    }
+
+    if (queue_held || queue_tail == queue_head) {
+        ep_busy = 0;
+        return;
+    }
+
+    report_queue_write(report_queue[queue_tail % REPORT_QUEUE_LEN]);
+    ++queue_tail;
+    ep_busy = 1;
+}
+
+#ifdef HIGH_RATE
+// host has read the last report, next one goes out on the next frame
+void report_queue_in(void) {
+    ep_busy = 0;
+}
+
+// start of frame
+void report_queue_frame(void) {
+    if (!ep_busy)
+        report_queue_send();
+}
+#else
+// host has read the last report
+// TIMER0_IRQHandler queues reports at the same priority as USB, so it
+// can't preempt this
+void report_queue_in(void) {
+    report_queue_send();
+}
+#endif
+
+// empty the queue and the endpoint, for a fresh run of the host trace
+void report_queue_reset(void) {
+    queue_head = queue_tail = 0;
+    ep_busy = keys_up = queue_held = 0;
+}
+
+// queue a report for the host
+// returns: 1 on success, 0 if the queue is full and the report must be
+// queued again later
+int usb_queue_report(uint8_t *report) {
+    if (queue_head - queue_tail == REPORT_QUEUE_LEN)
+        return 0;
+
+    memcpy(report_queue[queue_head % REPORT_QUEUE_LEN], report, REPORT_SIZE);
+    ++queue_head;
+    if (queue_head - queue_tail == REPORT_QUEUE_LEN)
+        ++report_queue_full;
+
+#ifndef HIGH_RATE
+    // endpoint is idle, so there will be no interrupt to send this one
+    if (!ep_busy)
+        report_queue_send();
+#endif
+
+    return 1;
+}
+
+// number of reports the host has not yet read
+unsigned usb_reports_pending(void) {
+    return queue_head - queue_tail + ep_busy + keys_up;
+}
+
+// send all keys up ahead of the queued reports
+// this and the two below must not be preempted by USB or TIMER0 interrupts
+void usb_keys_up(void) {
+    keys_up = 1;
+
+#ifndef HIGH_RATE
+    if (!ep_busy)
+        report_queue_send();
+#endif
+}
+
+// drop the reports the host has not yet read
+void usb_flush_reports(void) {
+    queue_tail = queue_head;
+}
+
+// keep the queued reports from the host, or let them go again
+void usb_hold_reports(int hold) {
+    queue_held = hold;
+
+#ifndef HIGH_RATE
+    if (!hold && !ep_busy)
+        report_queue_send();
+#endif
+}
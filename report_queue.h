@@ -0,0 +1,29 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __REPORT_QUEUE_H__
+#define __REPORT_QUEUE_H__
+
+#include <stdint.h>
+
+// The queue of HID reports between the script player and the interrupt
+// endpoint. The player's side is declared in usb.h. This is the endpoint's
+// side, driven by usb.c on the device and by the simulated host in
+// host/trace.c, so both run the same queue.
+
+#define REPORT_SIZE 8
+
+// write a report to the interrupt endpoint, supplied by the endpoint's owner
+void report_queue_write(const uint8_t *report);
+
+void report_queue_in(void);
+#ifdef HIGH_RATE
+void report_queue_frame(void);
+#endif
+void report_queue_reset(void);
+
+#endif /* __REPORT_QUEUE_H__ */
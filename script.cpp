@@ -0,0 +1,21 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+// script.txt for ducky.hpp, build it in with make SCRIPT_CPP=script.cpp.
+// Each payload is duckyscript in a raw string literal, and with more than
+// one each needs a TRIGGER.
+
+#include "ducky.hpp"
+
+DUCKY_SCRIPT(R"ducky(
+REM A simple demo that prints hello world
+
+STRING echo hello 
+DELAY 3000
+STRING world
+ENTER
+)ducky");
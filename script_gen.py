@@ -1,4 +1,4 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
 
 # Copyright 2019 Mike Ryan
 # 
@@ -8,9 +8,20 @@
 # This tool converts duckyscript into the binary format used internally
 # in Uberducky. It outputs a C array to stdout. The script file and the
 # name of the array are to be given as command line arguments
+#
+# Runs on Python 2.7 and 3. Scripts are read as Latin-1 so that each byte
+# of the file is one character, as the firmware types them.
 
+from __future__ import print_function
+
+import argparse
+import io
+import os
 import struct
 import sys
+import uuid
+
+import layout_gen
 
 keywords = set((
     'rem', 'gui', 'string', 'enter',
@@ -20,7 +31,8 @@ keywords = set((
     'leftarrow', 'left', 'rightarrow', 'right',
     'uparrow', 'up', 'downarrow', 'down',
     'tab', 'esc', 'escape', 'backspace', 'back',
-    'space', 'repeat', 'printscreen',
+    'space', 'repeat', 'printscreen', 'trigger',
+    'loop', 'endloop',
     'f1', 'f2', 'f3', 'f4', 'f5', 'f6',
     'f7', 'f8', 'f9', 'f10', 'f11', 'f12',
 ))
@@ -57,6 +69,37 @@ raw = {
     'printscreen': 0x46,
 }
 
+# largest argument that fits in a 16 bit opcode argument
+MAX_ARG = 0xffff
+
+# number of keys the firmware packs into one report
+HID_MAX_KEYS = 5
+
+# most payloads, PAYLOAD_MAX in payload.h: a trigger each, out of the 16 the
+# firmware has with 4 taken by the built in ones
+PAYLOAD_MAX = 16 - 4
+
+# deepest nesting of LOOPs, LOOP_DEPTH in bytecode.h
+LOOP_DEPTH = 4
+
+# keyboard layout of the target, set from the command line
+layout = layout_gen.get_layout('us')
+
+# HID usage and modifiers for a character, mirrors encode_char in hid.c
+# raises Exception if the keyboard layout has no key for the character
+def encode_char(c):
+    try:
+        return layout[c]
+    except KeyError:
+        raise Exception("Character %r cannot be typed with this keyboard layout" % c)
+
+# byte order of a UUID in an advertising packet
+def uuid_to_magic(arg):
+    try:
+        return uuid.UUID(arg.strip()).bytes[::-1]
+    except (AttributeError, ValueError):
+        raise Exception("Invalid trigger UUID '%s'" % arg)
+
 # convert arguments into canonical form
 # raises Exception if there is a problem with the arg
 def clean_arg(arg):
@@ -107,7 +150,7 @@ def clean_arg(arg):
 def load_script(file):
     parsed_script = []
 
-    with open(file, 'r') as f:
+    with io.open(file, 'r', encoding='latin-1', newline='') as f:
         for line in f:
             line = line.rstrip('\r\n')
             line = line.split(' ', 1)
@@ -119,6 +162,7 @@ def load_script(file):
 
     script = []
     default_delay = None
+    depth = 0 # of LOOPs
 
     for cmd, arg in parsed_script:
         if cmd == '':
@@ -158,6 +202,10 @@ def load_script(file):
         if cmd == 'rem':
             pass
 
+        # UUID that runs this script, Uberducky extension
+        elif cmd == 'trigger':
+            script.append({ 'type': 'trigger', 'value': uuid_to_magic(arg) })
+
         # string of characters
         elif cmd == 'string':
             if len(arg) > 0:
@@ -181,26 +229,235 @@ def load_script(file):
             count = 1
             if arg is not None:
                 count = int(arg)
+            if script and script[-1]['type'] in ('loop', 'endloop'):
+                raise Exception("REPEAT can't follow LOOP or ENDLOOP, change the LOOP count")
             script.append({ 'type': 'repeat', 'value': count })
 
+        # block of commands run count times, Uberducky extension
+        elif cmd == 'loop':
+            count = int(arg)
+            if count < 0 or count > MAX_ARG:
+                raise Exception("LOOP count must be 0 to %d" % MAX_ARG)
+            depth += 1
+            if depth > LOOP_DEPTH:
+                raise Exception("LOOPs nested more than %d deep" % LOOP_DEPTH)
+            script.append({ 'type': 'loop', 'value': count })
+
+        elif cmd == 'endloop':
+            if depth == 0:
+                raise Exception("ENDLOOP without LOOP")
+            depth -= 1
+            script.append({ 'type': 'endloop', 'value': None })
+
         else:
             script.append(clean_arg(cmd))
 
+    if depth != 0:
+        raise Exception("LOOP without ENDLOOP")
+
+    return script
+
+# HID modifier byte for a command's modifiers
+def cmd_mod(cmd):
+    mod = 0
+    for m in cmd.get('mods', []):
+        mod |= mods[m]
+    return mod
+
+# build an 8-byte report from a modifier byte and a list of keys
+def make_report(mod, keys):
+    return [mod, 0] + keys + [0] * (HID_MAX_KEYS + 1 - len(keys))
+
+# reports the firmware sends to type a string, including the final all keys
+# up report, mirrors hid_encode_string in hid.c
+def string_to_reports(value):
+    reports = []
+    held_keys, held_mod = [], None
+    pos = 0
+    while pos < len(value) or held_keys:
+        keys, mod = [], None
+        for c in value[pos:pos + HID_MAX_KEYS]:
+            key, m = encode_char(c)
+            if keys and (m != mod or key in keys):
+                break
+            if held_keys and (m != held_mod or key in held_keys):
+                break
+            keys.append(key)
+            mod = m
+        pos += len(keys)
+        held_keys, held_mod = keys, mod
+        reports.append(make_report(mod or 0, keys))
+    return reports
+
+def string_reports(value):
+    return len(string_to_reports(value))
+
+# key down and key up reports for a key command, mirrors hid_encode in hid.c
+def key_to_reports(cmd):
+    type, value = cmd['type'], cmd['value']
+    mod = cmd_mod(cmd)
+    if type == 'chr':
+        key, m = encode_char(value)
+        mod |= m
+    elif type == 'special':
+        key = { 'enter': 0x28, 'tab': 0x2b, 'esc': 0x29, 'back': 0x2a }[value]
+    elif type == 'fkey':
+        key = 0x3a + value - 1
+    elif type == 'arrow':
+        key = 0x4f + value
+    elif type == 'raw':
+        key = raw[value]
+    else:
+        raise Exception("Unhandled command '%s'" % type)
+    return [make_report(mod, [key] if key else []), make_report(0, [])]
+
+# make sure every character in a script can be typed
+def check_layout(script):
+    for cmd in script:
+        if cmd['type'] == 'string':
+            for c in cmd['value']:
+                encode_char(c)
+        elif cmd['type'] == 'chr':
+            encode_char(cmd['value'])
+
+# size in bytes of a command once compiled
+def cmd_size(cmd):
+    if cmd['type'] == 'string':
+        return 3 + len(cmd['value'])
+    if cmd['type'] in ('delay', 'repeat'):
+        return 3
+    if cmd['type'] == 'loop':
+        return 5
+    if cmd['type'] == 'endloop':
+        return 1
+    return 4
+
+# predicted running time of a script in ms, given the time each report
+# spends waiting for the host to poll it
+def script_time(script, down_time):
+    total = 0
+    prev = 0
+    loops = [] # (count, total before the loop)
+    for cmd in script:
+        if cmd['type'] == 'loop':
+            loops.append((cmd['value'], total))
+            total = 0
+            continue
+        elif cmd['type'] == 'endloop':
+            count, before = loops.pop()
+            total = before + total * count
+            continue
+        elif cmd['type'] == 'delay':
+            t = cmd['value']
+        elif cmd['type'] == 'string':
+            t = string_reports(cmd['value']) * down_time
+        elif cmd['type'] == 'repeat':
+            t = prev * cmd['value']
+        else: # key down, key up
+            t = 2 * down_time
+        total += t
+        prev = t
+    return total
+
+def script_size(script):
+    return 2 + sum(cmd_size(cmd) for cmd in script)
+
+# rewrite a parsed script into one that is smaller and faster but types the
+# same keys with the same delays:
+#  - single characters with no modifier are folded into strings
+#  - REPEAT of a delay becomes one longer delay, and REPEAT of a string is
+#    unrolled when that is no bigger than the REPEAT
+#  - adjacent strings are merged and adjacent delays are summed
+#  - empty strings, zero delays, REPEAT 0, empty LOOPs and trailing delays
+#    are dropped
+def optimize(script):
+    # fold characters into strings and resolve REPEATs against the command
+    # right before them, as the firmware would
+    out = []
+    for cmd in script:
+        cmd = dict(cmd)
+        if cmd['type'] == 'chr' and not cmd.get('mods'):
+            cmd = { 'type': 'string', 'value': cmd['value'] }
+
+        if cmd['type'] != 'repeat':
+            out.append(cmd)
+            continue
+
+        prev = out[-1] if out else None
+        n = cmd['value']
+        if n == 0 or prev is None:
+            continue
+
+        if not prev.get('pinned') and prev['type'] in ('delay', 'string'):
+            unit = prev.get('unit', prev['value'])
+            if prev['type'] == 'delay' or len(unit) * n <= cmd_size(cmd):
+                prev['unit'] = unit
+                prev['value'] += unit * n
+                continue
+            # too long to unroll, split the last copy off for REPEAT to replay
+            if prev['value'] != unit:
+                prev['value'] = prev['value'][:-len(unit)]
+                prev = { 'type': 'string', 'value': unit }
+                out.append(prev)
+
+        # the firmware replays the op right before the REPEAT, so nothing
+        # may be merged into it
+        prev['pinned'] = True
+        cmd['pinned'] = True
+        out.append(cmd)
+
+    # merge adjacent strings and delays
+    merged = []
+    for cmd in out:
+        cmd.pop('unit', None)
+        prev = merged[-1] if merged else None
+        if prev is not None and prev['type'] == 'loop' and cmd['type'] == 'endloop':
+            merged.pop()
+            continue
+        if prev is not None and prev['type'] == cmd['type'] and \
+                cmd['type'] in ('string', 'delay') and \
+                not prev.get('pinned') and not cmd.get('pinned'):
+            prev['value'] += cmd['value']
+            continue
+        merged.append(cmd)
+
+    # trailing delays only hold up the end of the script
+    while merged and merged[-1]['type'] == 'delay' and not merged[-1].get('pinned'):
+        merged.pop()
+
+    # split anything too long for a 16 bit argument and drop empty commands
+    script = []
+    for cmd in merged:
+        pinned = cmd.pop('pinned', False)
+        if cmd['type'] == 'string':
+            value = cmd['value']
+            if pinned and len(value) > MAX_ARG:
+                raise Exception('REPEAT of a string longer than %d chars' % MAX_ARG)
+            for i in range(0, len(value), MAX_ARG):
+                script.append(dict(cmd, value=value[i:i + MAX_ARG]))
+        elif cmd['type'] == 'delay':
+            value = cmd['value']
+            if pinned and value > MAX_ARG:
+                raise Exception('REPEAT of a delay longer than %d ms' % MAX_ARG)
+            while value > 0:
+                script.append(dict(cmd, value=min(value, MAX_ARG)))
+                value -= MAX_ARG
+        else:
+            script.append(cmd)
+
     return script
 
 def ducky_to_bin(parsed):
     script = []
-    for cmd in s:
+    loops = [] # (position of the LOOP in script, count)
+    for cmd in parsed:
         type, value = cmd['type'], cmd['value']
-
-        mod = 0
-        for m in cmd.get('mods', []):
-            mod |= mods[m]
+        mod = cmd_mod(cmd)
 
         if type == 'delay':
             script.append(struct.pack('<BH', 2, value))
         elif type == 'chr':
-            script.append(struct.pack('BBBc', 1, 0, mod, value))
+            script.append(struct.pack('BBBB', 1, 0, mod, ord(value)))
         elif type == 'special':
             script.append(struct.pack('BBBB', 1, special[value], mod, 0))
         elif type == 'fkey':
@@ -214,38 +471,240 @@ def ducky_to_bin(parsed):
         elif type == 'string':
             l = len(value)
             script.append(struct.pack('<BH', 3, l))
-            script.append(value)
+            script.append(value.encode('latin-1'))
         elif type == 'repeat':
             script.append(struct.pack('<BH', 4, value))
+        elif type == 'loop':
+            # the bytes to skip for LOOP 0 are filled in at the ENDLOOP
+            loops.append((len(script), value))
+            script.append(None)
+        elif type == 'endloop':
+            script.append(struct.pack('B', 6))
+            start, count = loops.pop()
+            skip = sum(len(op) for op in script[start + 1:])
+            if skip > MAX_ARG:
+                raise Exception('LOOP body longer than %d bytes' % MAX_ARG)
+            script[start] = struct.pack('<BHH', 5, count, skip)
         else:
             raise Exception("Unhandled command '%s'" % cmd[0])
 
-    binary_script = ''.join(script)
-    l = struct.pack('<H', len(binary_script))
-
-    return ''.join((l, binary_script))
+    return b''.join(script)
+
+# expand LOOPs into copies of their body, for the report stream which has
+# no loops of its own
+def unroll(parsed):
+    out = []
+    loops = [] # (count, position of the body in out)
+    for cmd in parsed:
+        if cmd['type'] == 'loop':
+            loops.append((cmd['value'], len(out)))
+        elif cmd['type'] == 'endloop':
+            count, start = loops.pop()
+            out[start:] = out[start:] * count
+        else:
+            out.append(cmd)
+    return out
+
+# report stream record with a delay instead of a report, see uberducky.c
+STREAM_DELAY = 0x02
+
+# render a script into the report stream the firmware would have sent,
+# each report delta coded against the one before it
+def ducky_to_reports(parsed):
+    parsed = unroll(parsed)
+    stream = []
+    prev = [0] * 8
+    prev_events = []
+    count = 0
+    for cmd in parsed:
+        type, value = cmd['type'], cmd['value']
+        if type == 'delay':
+            events = [value]
+        elif type == 'string':
+            events = string_to_reports(value)
+        elif type == 'repeat':
+            events = prev_events * value
+        else:
+            events = key_to_reports(cmd)
+        if type != 'repeat':
+            prev_events = events
+
+        for event in events:
+            if isinstance(event, int):
+                stream.append(struct.pack('<BH', STREAM_DELAY, event))
+                continue
+            mask = 0
+            changed = []
+            for i in range(8):
+                if event[i] != prev[i]:
+                    mask |= 1 << i
+                    changed.append(event[i])
+            stream.append(struct.pack('%dB' % (1 + len(changed)), mask, *changed))
+            prev = event
+            count += 1
+
+    sys.stderr.write('reports:    %6d\n' % count)
+    return b''.join(stream)
+
+# the uncompressed formats start with their length (16 bit)
+def with_length(bin):
+    if len(bin) > 0xffff:
+        raise Exception('Script is %d bytes, more than fits uncompressed, '
+                        'build with COMPRESS=1' % len(bin))
+    return struct.pack('<H', len(bin)) + bin
+
+# bytes of bytecode per compressed block, PAYLOAD_BLOCK_SIZE in payload.h
+BLOCK_SIZE = 512
+
+# LZSS compress one block, see payload.c for the format
+def lzss(block):
+    out = []
+    items = []
+    pos = 0
+    while pos < len(block):
+        best_len, best_dist = 0, 0
+        for start in range(max(0, pos - 0x1000), pos):
+            l = 0
+            while l < 18 and pos + l < len(block) and block[start + l] == block[pos + l]:
+                l += 1
+            if l >= best_len:
+                best_len, best_dist = l, pos - start
+        if best_len >= 3:
+            items.append(struct.pack('<H', ((best_len - 3) << 12) | (best_dist - 1)))
+            pos += best_len
+        else:
+            items.append(block[pos:pos + 1])
+            pos += 1
+    for i in range(0, len(items), 8):
+        group = items[i:i + 8]
+        flags = 0
+        for j, item in enumerate(group):
+            if len(item) == 1:
+                flags |= 1 << j
+        out.append(struct.pack('B', flags))
+        out.extend(group)
+    return b''.join(out)
+
+# compress bytecode into independently decompressible blocks
+def compress(bytecode):
+    blocks = [lzss(bytecode[i:i + BLOCK_SIZE])
+              for i in range(0, len(bytecode), BLOCK_SIZE)]
+    offsets = []
+    offset = 0
+    for block in blocks:
+        offsets.append(struct.pack('<I', offset))
+        offset += len(block)
+    return b''.join([struct.pack('<I', len(bytecode))] + offsets + blocks)
 
 def bin_to_c(script, array_name):
-    print '#include <stdint.h>'
-    print 'uint8_t %s[%d] = {' % (array_name, len(script))
-    print '   ',
-    for i in range(0, len(script)):
-        print '0x%02x,' % ord(script[i]),
-        if i & 7 == 7 and i != len(script) - 1:
-            print '\n   ',
-    print '\n};'
+    data = bytearray(script)
+    print('const uint8_t %s[%d] = {' % (array_name, len(data)))
+    for i in range(0, len(data), 8):
+        print('    ' + ''.join('0x%02x, ' % b for b in data[i:i + 8]))
+    print('};')
+
+# size and predicted running time, printed to stderr since the C array goes
+# to stdout
+def report(label, script, down_time):
+    t = script_time(script, down_time)
+    sys.stderr.write('%-10s %6d bytes, %8.3f s\n' % (label, script_size(script), t / 1000.0))
+
+# take the TRIGGER out of a script
+# returns: (trigger magic or None for the default trigger, script)
+def split_trigger(script):
+    triggers = [cmd['value'] for cmd in script if cmd['type'] == 'trigger']
+    if len(triggers) > 1:
+        raise Exception('More than one TRIGGER')
+    script = [cmd for cmd in script if cmd['type'] != 'trigger']
+    return (triggers[0] if triggers else None, script)
+
+# compile a duckyscript into the payload the firmware runs
+# returns: (trigger magic or None, payload)
+def compile_script(path, args):
+    s = load_script(path)
+    magic, s = split_trigger(s)
+    check_layout(s)
+    report('script:', s, args.down_time)
+    if not args.no_optimize:
+        s = optimize(s)
+        report('optimized:', s, args.down_time)
+    if args.reports:
+        bin = ducky_to_reports(s)
+    else:
+        bin = ducky_to_bin(s)
+    if args.compress:
+        bin = compress(bin)
+        sys.stderr.write('compressed: %6d bytes\n' % len(bin))
+    else:
+        bin = with_length(bin)
+    return (magic, bin)
+
+# payload index read by payload.c, all little endian:
+#  count       number of payloads (16 bit)
+#  entries     trigger UUID (16 bytes, all zero for the default trigger) and
+#              offset of the payload in the script array (32 bit)
+def build_index(payloads):
+    if len(payloads) > PAYLOAD_MAX:
+        raise Exception("%d payloads, the firmware has triggers for %d" % (len(payloads), PAYLOAD_MAX))
+    index = [struct.pack('<H', len(payloads))]
+    offset = 0
+    seen = set()
+    for path, magic, bin in payloads:
+        if magic in seen:
+            raise Exception("%s: trigger is used by another payload" % path)
+        seen.add(magic)
+        index.append(magic or b'\0' * 16)
+        index.append(struct.pack('<I', offset))
+        offset += len(bin)
+    return b''.join(index)
+
+# a directory holds one payload per .txt file
+def script_paths(path):
+    if not os.path.isdir(path):
+        return [path]
+    paths = sorted(os.path.join(path, f) for f in os.listdir(path) if f.endswith('.txt'))
+    if not paths:
+        raise Exception("No .txt scripts in %s" % path)
+    return paths
 
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Convert duckyscript to Uberducky bytecode')
+    parser.add_argument('path', metavar='duckyscript',
+                        help='script, or directory of scripts that each have a TRIGGER')
+    parser.add_argument('array_name')
+    parser.add_argument('--down-time', type=int, default=10,
+                        help='ms each report waits for the host, DOWN_TIME in hid.h')
+    parser.add_argument('--no-optimize', action='store_true',
+                        help='emit one opcode per line of the script')
+    parser.add_argument('--layout', default='us',
+                        help='keyboard layout of the target, see layout_gen.py')
+    parser.add_argument('--reports', action='store_true',
+                        help='emit a rendered report stream, firmware must be built with REPORTS=1')
+    parser.add_argument('--compress', action='store_true',
+                        help='emit compressed bytecode, firmware must be built with COMPRESS=1')
+    parser.add_argument('--image', action='store_true',
+                        help='emit a binary image to upload with ducky_upload.py instead of C')
+    args = parser.parse_args()
+
+    path = args.path
     try:
-        path = sys.argv[1]
-        array_name = sys.argv[2]
-    except IndexError:
-        print "Usage: %s <duckyscript> <array_name>" % sys.argv[0]
-        exit(1)
-
-    try:
-        s = load_script(path)
-        bin = ducky_to_bin(s)
-        bin_to_c(bin, array_name)
-    except Exception, e:
-        print "Problem converting duckyscript: %s" % e
+        layout = layout_gen.get_layout(args.layout)
+        payloads = []
+        for path in script_paths(args.path):
+            sys.stderr.write('%s\n' % path)
+            magic, bin = compile_script(path, args)
+            payloads.append((path, magic, bin))
+        path = args.path
+        index = build_index(payloads)
+
+        if args.image:
+            # the index followed by the payloads, as payload.c reads it
+            out = getattr(sys.stdout, 'buffer', sys.stdout)
+            out.write(index + b''.join(bin for _, _, bin in payloads))
+        else:
+            print('#include <stdint.h>')
+            bin_to_c(b''.join(bin for _, _, bin in payloads), args.array_name)
+            bin_to_c(index, args.array_name + '_index')
+    except Exception as e:
+        print("Problem converting duckyscript %s: %s" % (path, e))
+        sys.exit(1)
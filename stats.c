@@ -0,0 +1,91 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "stats.h"
+#include "usb.h"
+#include "payload.h"
+#ifdef OTA_UPLOAD
+#include "ota.h"
+#endif
+#ifdef ADAPTIVE_RATE
+#include "rate.h"
+#endif
+
+#include <string.h>
+
+uint32_t trigger_latency = 0;
+uint32_t trigger_latency_max = 0;
+uint32_t abort_latency = 0;
+uint32_t abort_latency_max = 0;
+uint32_t loop_latency_max = 0;
+
+// gather the counters kept by each part of the firmware, counters updated
+// by interrupts may move on while this runs
+void stats_snapshot(uint32_t *words) {
+    unsigned i;
+
+    memset(words, 0, STATS_WORDS * 4);
+    words[STAT_VERSION] = STATS_VERSION;
+    words[STAT_COUNTERS] = STAT_COUNTERS_END - STAT_PACKETS;
+
+    for (i = 0; i < BLE_ADV_CHANNELS; ++i) {
+        words[STAT_PACKETS] += ble_stats[i].packets;
+        memcpy(&words[STAT_CHANNEL(i)], &ble_stats[i], sizeof(ble_stats[i]));
+    }
+    words[STAT_BAD_HEADER] = ble_rx_bad_header;
+    words[STAT_BAD_CRC] = ble_rx_bad_crc;
+    words[STAT_RX_OVERRUNS] = ble_rx_overruns;
+    words[STAT_RADIO_TIMEOUTS] = ble_radio_timeouts;
+    words[STAT_REPORT_QUEUE_FULL] = report_queue_full;
+    words[STAT_LOOP_MAX] = loop_latency_max;
+    words[STAT_TRIGGER_LATENCY] = trigger_latency;
+    words[STAT_TRIGGER_LATENCY_MAX] = trigger_latency_max;
+    words[STAT_ABORT_LATENCY] = abort_latency;
+    words[STAT_ABORT_LATENCY_MAX] = abort_latency_max;
+    words[STAT_PAYLOADS_UNTRIGGERED] = payload_untriggered;
+#ifdef OTA_UPLOAD
+    words[STAT_OTA_CHUNKS] = ota_chunks;
+    words[STAT_OTA_DUPLICATES] = ota_duplicates;
+    words[STAT_OTA_COMMITS] = ota_commits;
+    words[STAT_OTA_FAILURES] = ota_failures;
+#endif
+#ifdef ADAPTIVE_RATE
+    words[STAT_RATE_DOWN_TIME] = rate_down_time;
+    words[STAT_RATE_LAG] = rate_lag;
+    words[STAT_RATE_PROBES] = rate_probes;
+    words[STAT_RATE_TIMEOUTS] = rate_timeouts;
+#endif
+
+    words[STAT_TRIGGERS] = trigger_registered();
+    for (i = 0; i < TRIGGER_MAX; ++i)
+        words[STAT_TRIGGER_HITS(i)] = trigger_hits[i];
+}
+
+void stats_reset(void) {
+    memset(ble_stats, 0, sizeof(ble_stats));
+    ble_rx_bad_header = 0;
+    ble_rx_bad_crc = 0;
+    ble_rx_overruns = 0;
+    ble_radio_timeouts = 0;
+    report_queue_full = 0;
+    loop_latency_max = 0;
+    trigger_latency = 0;
+    trigger_latency_max = 0;
+    abort_latency = 0;
+    abort_latency_max = 0;
+#ifdef OTA_UPLOAD
+    ota_chunks = 0;
+    ota_duplicates = 0;
+    ota_commits = 0;
+    ota_failures = 0;
+#endif
+#ifdef ADAPTIVE_RATE
+    rate_probes = 0;
+    rate_timeouts = 0;
+#endif
+    memset(trigger_hits, 0, sizeof(trigger_hits));
+}
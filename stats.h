@@ -0,0 +1,74 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+#include "ble.h"
+#include "trigger.h"
+
+// vendor requests, device recipient
+#define STATS_REQ_GET       0x01    // IN, STATS_WORDS words
+#define STATS_REQ_RESET     0x02    // no data
+
+// layout of STATS_REQ_GET, 32 bit little endian words, ducky_stats.py must
+// match it
+//
+// Words never move once added. A new counter goes at the end of the
+// counters, before STAT_COUNTERS_END, and readers find the words after the
+// counters from STAT_COUNTERS, so they can read older and newer firmware.
+// STATS_VERSION only changes if the layout has to change some other way.
+#define STATS_VERSION           1
+
+#define STAT_VERSION            0   // STATS_VERSION
+#define STAT_COUNTERS           1   // number of counters that follow
+#define STAT_PACKETS            2   // valid advertisements, all channels
+#define STAT_BAD_HEADER         3
+#define STAT_BAD_CRC            4
+#define STAT_RX_OVERRUNS        5
+#define STAT_RADIO_TIMEOUTS     6
+#define STAT_REPORT_QUEUE_FULL  7   // times the player waited for the host
+#define STAT_LOOP_MAX           8   // us, longest main loop iteration
+#define STAT_TRIGGER_LATENCY    9   // us, last trigger
+#define STAT_TRIGGER_LATENCY_MAX 10 // us, worst trigger
+#define STAT_OTA_CHUNKS         11  // over the air upload, see ota.h
+#define STAT_OTA_DUPLICATES     12
+#define STAT_OTA_COMMITS        13
+#define STAT_OTA_FAILURES       14
+#define STAT_RATE_DOWN_TIME     15  // ms, adaptive typing rate, see rate.h
+#define STAT_RATE_LAG           16  // ms, echo lag of the last probe
+#define STAT_RATE_PROBES        17
+#define STAT_RATE_TIMEOUTS      18
+#define STAT_ABORT_LATENCY      19  // us, last abort to all keys up read
+#define STAT_ABORT_LATENCY_MAX  20  // us, worst abort
+#define STAT_PAYLOADS_UNTRIGGERED 21 // payloads with no room for their trigger
+#define STAT_COUNTERS_END       22
+
+#define STAT_CHANNEL(n)         (STAT_COUNTERS_END + (n) * 4) // ble_channel_stats_t
+#define STAT_TRIGGERS           STAT_CHANNEL(BLE_ADV_CHANNELS) // registered
+#define STAT_TRIGGER_HITS(n)    (STAT_TRIGGERS + 1 + (n)) // in trigger_add order
+#define STATS_WORDS             STAT_TRIGGER_HITS(TRIGGER_MAX)
+
+// us from the end of a trigger packet on air to the script being scheduled,
+// for the last trigger and the worst seen
+extern uint32_t trigger_latency;
+extern uint32_t trigger_latency_max;
+
+// us from the end of an abort packet on air to the host reading the all keys
+// up report after it, for the last abort of a script and the worst seen
+extern uint32_t abort_latency;
+extern uint32_t abort_latency_max;
+
+// us, longest trip round the main loop
+extern uint32_t loop_latency_max;
+
+void stats_snapshot(uint32_t *words);
+void stats_reset(void);
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "trigger.h"
+#include "ble.h"
+
+#include <string.h>
+
+// magic string that must be present in trigger packets, used by payloads
+// that don't name their own trigger UUID
+// derived from random UUID:
+// fd123ff9-9e30-45b2-af0d-b85b7d2dc80c
+uint8_t ble_magic[16] = {
+    0x0c, 0xc8, 0x2d, 0x7d, 0x5b, 0xb8, 0x0d, 0xaf,
+    0xb2, 0x45, 0x30, 0x9e, 0xf9, 0x3f, 0x12, 0xfd,
+};
+
+// magic string that triggers bootloader mode
+// random UUID:
+// 344bc7f2-5619-4953-9be8-9888fe29d996
+uint8_t bootloader_magic[16] = {
+    0x96, 0xd9, 0x29, 0xfe, 0x88, 0x98, 0xe8, 0x9b,
+    0x53, 0x49, 0x19, 0x56, 0xf2, 0xc7, 0x4b, 0x34,
+};
+
+// magic strings that abort, pause and resume the running script
+// random UUIDs:
+// 9cd7d80f-9a6f-4249-acff-d1d90f1bf131
+uint8_t abort_magic[16] = {
+    0x31, 0xf1, 0x1b, 0x0f, 0xd9, 0xd1, 0xff, 0xac,
+    0x49, 0x42, 0x6f, 0x9a, 0x0f, 0xd8, 0xd7, 0x9c,
+};
+
+// d3cc4e2d-4c65-45dc-9743-5315a3152739
+uint8_t pause_magic[16] = {
+    0x39, 0x27, 0x15, 0xa3, 0x15, 0x53, 0x43, 0x97,
+    0xdc, 0x45, 0x65, 0x4c, 0x2d, 0x4e, 0xcc, 0xd3,
+};
+
+// cdcdbda3-31b5-46d2-a648-c5842b5a4de5
+uint8_t resume_magic[16] = {
+    0xe5, 0x4d, 0x5a, 0x2b, 0x84, 0xc5, 0x48, 0xa6,
+    0xd2, 0x46, 0xb5, 0x31, 0xa3, 0xbd, 0xcd, 0xcd,
+};
+
+// Matching
+//
+// A 16 byte UUID anywhere in the packet always covers exactly one 32 bit
+// word that is aligned in the packet, which is UUID bytes k..k+3 for some k
+// in 0..3. Every trigger puts its four candidate words in a hash table, so
+// a packet is matched by looking up each of its aligned words once and
+// comparing the full UUID only on a hit. The cost per packet depends on the
+// packet size, not on the number of triggers.
+
+#ifndef TRIGGER_HASH_BITS
+#define TRIGGER_HASH_BITS 8
+#endif
+
+#define HASH_SIZE   (1 << TRIGGER_HASH_BITS)
+#define HASH(w)     (((w) * 0x9e3779b1u) >> (32 - TRIGGER_HASH_BITS))
+
+// keep probe chains short by leaving at least 3/4 of the table empty
+#if HASH_SIZE < TRIGGER_MAX * 4 * 4
+#error "trigger hash table is too small for TRIGGER_MAX"
+#endif
+
+typedef struct _trigger_t {
+    uint8_t uuid[16];
+    int type;
+    int arg;    // e.g. payload to run, passed back by trigger_check
+} trigger_t;
+
+static trigger_t triggers[TRIGGER_MAX];
+static unsigned trigger_count = 0;
+
+uint32_t trigger_hits[TRIGGER_MAX];
+
+// hash table of words that may be part of a trigger, kept as two arrays so
+// that a slot costs 5 bytes of RAM
+static uint32_t probe_word[HASH_SIZE];
+static uint8_t probe_tag[HASH_SIZE]; // 0 if empty, else see PROBE_TAG
+
+#define PROBE_TAG(t, k)     ((((t) + 1) << 2) | (k))
+#define TAG_TRIGGER(tag)    (((tag) >> 2) - 1)
+#define TAG_OFFSET(tag)     ((tag) & 3)
+
+#if TRIGGER_MAX > 63
+#error "probe tags only have room for 63 triggers"
+#endif
+
+static uint32_t load_word(const uint8_t *p) {
+    uint32_t w;
+    memcpy(&w, p, 4);
+    return w;
+}
+
+// register a trigger UUID, triggers added first win if a packet has several
+// returns: index of the trigger, -1 if the table is full
+int trigger_add(const uint8_t *uuid, int type, int arg) {
+    unsigned k, h;
+
+    if (trigger_count == TRIGGER_MAX)
+        return -1;
+
+    memcpy(triggers[trigger_count].uuid, uuid, 16);
+    triggers[trigger_count].type = type;
+    triggers[trigger_count].arg = arg;
+
+    for (k = 0; k < 4; ++k) {
+        uint32_t w = load_word(uuid + k);
+        for (h = HASH(w); probe_tag[h] != 0; h = (h + 1) % HASH_SIZE)
+            ;
+        probe_word[h] = w;
+        probe_tag[h] = PROBE_TAG(trigger_count, k);
+    }
+
+    return trigger_count++;
+}
+
+// register the built in triggers, payloads add theirs afterwards
+void trigger_init(void) {
+    trigger_count = 0;
+    memset(probe_tag, 0, sizeof(probe_tag));
+
+    trigger_add(bootloader_magic, TRIGGER_BOOTLOADER, 0);
+    trigger_add(abort_magic, TRIGGER_ABORT, 0);
+    trigger_add(pause_magic, TRIGGER_PAUSE, 0);
+    trigger_add(resume_magic, TRIGGER_RESUME, 0);
+}
+
+// find the trigger UUID in a dewhitened packet
+// returns: index of the trigger, -1 if none is present
+int trigger_match(uint8_t *packet) {
+    unsigned i, h;
+    int start, best = TRIGGER_MAX;
+
+    for (i = 0; i < BLE_PACKET_SIZE; i += 4) {
+        uint32_t w = load_word(packet + i);
+
+        for (h = HASH(w); probe_tag[h] != 0; h = (h + 1) % HASH_SIZE) {
+            int t = TAG_TRIGGER(probe_tag[h]);
+            if (probe_word[h] != w || t >= best)
+                continue;
+
+            start = (int)i - TAG_OFFSET(probe_tag[h]);
+            if (start < 0 || start > BLE_PACKET_SIZE - 16)
+                continue;
+
+            if (memcmp(packet + start, triggers[t].uuid, 16) == 0)
+                best = t;
+        }
+    }
+
+    return best == TRIGGER_MAX ? -1 : best;
+}
+
+// decide what, if anything, a dewhitened packet triggers
+// output: arg, argument the trigger was registered with, may be NULL
+int trigger_check(uint8_t *packet, int *arg) {
+    int t = trigger_match(packet);
+    if (t < 0)
+        return TRIGGER_NONE;
+    ++trigger_hits[t];
+    if (arg != NULL)
+        *arg = triggers[t].arg;
+    return triggers[t].type;
+}
+
+// number of triggers added so far
+unsigned trigger_registered(void) {
+    return trigger_count;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __TRIGGER_H__
+#define __TRIGGER_H__
+
+#include <stdint.h>
+
+// trigger types
+#define TRIGGER_NONE        0
+#define TRIGGER_SCRIPT      1
+#define TRIGGER_BOOTLOADER  2
+#define TRIGGER_ABORT       3   // stop the running script
+#define TRIGGER_PAUSE       4   // hold the running script
+#define TRIGGER_RESUME      5   // carry on with a held script
+#define TRIGGER_TYPES       6
+
+// most trigger UUIDs that can be registered
+#ifndef TRIGGER_MAX
+#define TRIGGER_MAX 16
+#endif
+
+// triggers trigger_init registers, the rest are left for payloads
+#define TRIGGER_BUILTIN 4
+
+extern uint8_t ble_magic[16];
+extern uint8_t bootloader_magic[16];
+extern uint8_t abort_magic[16];
+extern uint8_t pause_magic[16];
+extern uint8_t resume_magic[16];
+
+// times each trigger was seen, in trigger_add order
+extern uint32_t trigger_hits[TRIGGER_MAX];
+
+void trigger_init(void);
+int trigger_add(const uint8_t *uuid, int type, int arg);
+int trigger_match(uint8_t *packet);
+int trigger_check(uint8_t *packet, int *arg);
+unsigned trigger_registered(void);
+
+#endif /* __TRIGGER_H__ */
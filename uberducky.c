@@ -7,87 +7,110 @@
 
 #include "hid.h"
 #include "ble.h"
+#include "usb.h"
+#include "trigger.h"
+#include "payload.h"
+#include "stats.h"
+#include "event.h"
+#include "bytecode.h"
+#ifdef ADAPTIVE_RATE
+#include "rate.h"
+#endif
+#ifdef SCRIPT_UPLOAD
+#include "upload.h"
+#endif
+#ifdef OTA_UPLOAD
+#include "ota.h"
+#endif
 
-#include "type.h"
 #include "ubertooth.h"
-#include "usbapi.h"
 
 #include <string.h>
 
-// magic string that must be present in trigger packets
-// derived from random UUID:
-// fd123ff9-9e30-45b2-af0d-b85b7d2dc80c
-uint8_t ble_magic[16] = {
-    0x0c, 0xc8, 0x2d, 0x7d, 0x5b, 0xb8, 0x0d, 0xaf,
-    0xb2, 0x45, 0x30, 0x9e, 0xf9, 0x3f, 0x12, 0xfd,
-};
-
-// magic string that triggers bootloader mode
-// random UUID:
-// 344bc7f2-5619-4953-9be8-9888fe29d996
-uint8_t bootloader_magic[16] = {
-    0x96, 0xd9, 0x29, 0xfe, 0x88, 0x98, 0xe8, 0x9b,
-    0x53, 0x49, 0x19, 0x56, 0xf2, 0xc7, 0x4b, 0x34,
-};
-
-extern uint8_t script[]; // auto-generated from duckyscript input
-
 // times in ms
 #define LED_PERIOD      600
 #define LED_ON_TIME     100
 
-#define INTR_IN_EP      0x81
-
 #define LE_WORD(x)      ((x)&0xFF),((x)>>8)
-#define READ_LE(x)      ((script[x+1] << 8) | script[x])
 
 #define NOW T0TC
 
+// sleep until an interrupt or event, host builds have nothing to wait for
+#ifndef WFE
+#define WFE() asm volatile ("wfe")
+#endif
+
 // script state
 #define ST_IDLE     0
-#define ST_READY    1
-#define ST_RUNNING  2
-
-// run state
-#define R_IDLE      0
-#define R_KEY_DOWN  1
-#define R_DELAY     2
-#define R_STRING    3
+#define ST_RUNNING  1
+#define ST_PAUSED   2   // held by the pause trigger
+
+// decode state
+#define D_IDLE      0   // read the next opcode
+#define D_KEY       1
+#define D_KEY_UP    2
+#define D_STRING    3
+#define D_DONE      4   // end of script decoded
+
+// ms until the report after a queued one may be queued, reports otherwise
+// go as fast as the host reads them
+#ifdef ADAPTIVE_RATE
+#define REPORT_HOLD rate_down_time
+#else
+#define REPORT_HOLD 1
+#endif
 
-// string state
-#define S_IDLE      0
-#define S_KEY_DOWN  1
+// most decode steps per trip round the main loop
+#define DECODE_STEPS 32
 
 int script_state = ST_IDLE;
-int run_state = R_IDLE;
-int string_state = S_IDLE;
+
+// The main loop decodes the script into an event ring (see event.h) ahead
+// of TIMER0_IRQHandler, which only takes events out and queues their
+// reports, so the time spent reading the script, decompressing it or
+// walking repeats never delays a key.
+
+// decoder, main loop only
+int decode_state = D_IDLE;
+uint32_t pending_delay = 0; // goes on the next event
 
 unsigned script_len = 0;
 unsigned script_pos = 0;
+keystroke_t script_key = { 0, };
 unsigned string_len = 0;
 unsigned string_pos = 0;
+uint8_t string_report[8] = { 0, }; // keys currently held by the string
 
 uint32_t repeat_counter = 0;
 unsigned repeat_pos = 0;
 int repeating = 0;
 
-// opcodes
-//
-// encoding: <op> [<arg> .. ]
-// 
-// NOP - no args
-// KEY - key type, modifier, character (each 1 byte)
-// DELAY - delay in ms (16 bit little endian)
-// STRING - length (16 bit little endian), chars
-// REPEAT - repeat previous command
-#define OP_NOP    0
-#define OP_KEY    1
-#define OP_DELAY  2
-#define OP_STRING 3
-#define OP_REPEAT 4
+// open LOOPs, innermost last
+typedef struct _loop_t {
+    unsigned body;      // script_pos of the first op in the loop
+    uint16_t left;      // times the body is still to run
+} loop_t;
+
+loop_t loop_stack[LOOP_DEPTH];
+unsigned loop_depth = 0;
 
+// player, TIMER0_IRQHandler only
+int delay_done = 0; // the delay of the oldest event is over
+
+// opcodes are in bytecode.h
 #define DELAY(X) OP_DELAY, LE_WORD(X)
 
+// report stream, used instead of opcodes in REPORT_STREAM builds
+//
+// encoding: <mask> [<byte> .. ]
+//
+// each record is a report given as the bytes that differ from the report
+// before it, bit n of mask is set if byte n follows. byte 1 of a report is
+// reserved and always 0, so a mask of STREAM_DELAY instead means:
+//
+// DELAY - delay in ms (16 bit little endian)
+#define STREAM_DELAY 0x02
+
 // demo script - print hello world
 /* this is now loaded from an autogenerated .c file
 uint8_t script[] = {
@@ -109,10 +132,33 @@ static void timer0_start(void) {
     T0PR = 50000 - 1; // 1 ms
     T0TCR = TCR_Counter_Enable;
 
+    // MR2 ticks every ms to wake the main loop from sleep
+    T0MR2 = 1;
+    T0MCR |= TMCR_MR2I;
+
     // set up interrupt handler
     ISER0 = ISER0_ISE_TIMER0;
 }
 
+// NVIC interrupt numbers, LPC17xx user manual table 50
+#define IRQ_TIMER0  1
+#define IRQ_EINT3   21
+#define IRQ_USB     24
+
+// the LPC17xx implements the top 5 bits of each priority byte, 0 is highest
+static void irq_priority(unsigned irq, unsigned prio) {
+    ((volatile uint8_t *)&IPR0)[irq] = prio << 3;
+}
+
+// the packet interrupt only empties the radio FIFO and must not wait behind
+// anything. TIMER0 and USB share a level so neither preempts the other while
+// it touches the report queue or the USB controller.
+static void irq_init(void) {
+    irq_priority(IRQ_EINT3, 0);
+    irq_priority(IRQ_TIMER0, 1);
+    irq_priority(IRQ_USB, 1);
+}
+
 static void timer0_set_match(uint32_t match) {
     T0MR0 = match;
     T0MCR |= TMCR_MR0I;
@@ -122,142 +168,342 @@ static void timer0_clear_match(void) {
     T0MCR &= ~TMCR_MR0I;
 }
 
-void TIMER0_IRQHandler(void) {
-    uint8_t report[8] = { 0, };
-    keystroke_t next_key = { 0, };
+// hand a report to TIMER0_IRQHandler along with the delay before it
+// returns: 1 on success, 0 if the ring is full
+static int decode_emit(uint8_t *report, int end) {
+    script_event_t *ev = event_slot();
 
-    if (T0IR & TIR_MR0_Interrupt) {
-        // ack the interrupt
-        T0IR = TIR_MR0_Interrupt;
+    if (ev == NULL)
+        return 0;
 
-        if (script_state == ST_READY) {
-            script_pos = 0;
-            script_state = ST_RUNNING;
-            run_state = R_IDLE;
+    ev->delay = pending_delay;
+    ev->end = end;
+    memcpy(ev->report, report, 8);
+    event_push();
 
-            script_len = READ_LE(script_pos);
-            script_pos += 2;
+    pending_delay = 0;
+    return 1;
+}
 
-            // re-enter in 1 ms
-            timer0_set_match(NOW + 1);
-        } else if (script_state == ST_RUNNING) {
-            uint8_t opcode;
-            uint16_t delay;
-            switch (run_state) {
-                // idle -- get next opcode
-                case R_IDLE:
-                    if (script_pos >= script_len) {
-                        script_state = ST_IDLE;
-                        return;
-                    }
+#ifdef REPORT_STREAM
+uint8_t stream_report[8] = { 0, }; // last report read from the stream
 
-                    if (repeating) {
-                        if (repeat_counter == 0) {
-                            repeating = 0;
-                            script_pos += 3; // skip repeat opcode
-                        } else {
-                            --repeat_counter;
-                            script_pos = repeat_pos; // jump back to prev op
-                        }
-                    }
+// decode one record of the stream
+static void decode_step(void) {
+    uint8_t mask, report[8] = { 0, };
+    unsigned pos, i;
 
-                    opcode = script[script_pos++];
-                    if (opcode != OP_REPEAT)
-                        repeat_pos = script_pos-1;
-
-                    switch (opcode) {
-                        case OP_NOP:
-                            ++script_pos;
-                            timer0_set_match(NOW + 1); // re-enter in 1 ms
-                            return;
-
-                        case OP_KEY:
-                            // TODO bounds check
-                            next_key.type = script[script_pos++];
-                            next_key.mod = script[script_pos++];
-                            next_key.chr = script[script_pos++];
-
-                            // encode and inject key
-                            hid_encode(&next_key, report);
-                            USBHwEPWrite(INTR_IN_EP, report, 8);
-                            run_state = R_KEY_DOWN;
-                            timer0_set_match(NOW + DOWN_TIME);
-                            return;
-
-                        case OP_DELAY:
-                            // TODO bounds check
-                            delay = READ_LE(script_pos);
-                            script_pos += 2;
-                            run_state = R_DELAY;
-                            timer0_set_match(NOW + delay);
-                            return;
-
-                        case OP_STRING:
-                            // TODO bounds check
-                            string_len = READ_LE(script_pos);
-                            string_pos = 0;
-                            script_pos += 2;
-                            run_state = R_STRING;
-                            string_state = S_IDLE;
-                            timer0_set_match(NOW + 1); // re-enter in 1 ms
-                            return;
-
-                        case OP_REPEAT:
-                            repeating = 1;
-                            repeat_counter = READ_LE(script_pos);
-                            timer0_set_match(NOW + 1); // re-enter in 1 ms
-                            return;
-                    }
+    if (script_pos >= script_len) {
+        if (decode_emit(report, 1))
+            decode_state = D_DONE;
+        return;
+    }
+
+    mask = payload_byte(script_pos);
+
+    if (mask == STREAM_DELAY) {
+        pending_delay += payload_word(script_pos + 1);
+        script_pos += 3;
+        return;
+    }
+
+    memcpy(report, stream_report, 8);
+    pos = script_pos + 1;
+    for (i = 0; i < 8; ++i)
+        if (mask & (1 << i))
+            report[i] = payload_byte(pos++);
+
+    if (decode_emit(report, 0)) {
+        memcpy(stream_report, report, 8);
+        script_pos = pos;
+    }
+}
+#else
+// decode the script by at most one event, a state that fails to emit its
+// event tries again on the next step
+static void decode_step(void) {
+    uint8_t report[8] = { 0, };
+    uint8_t opcode;
+    uint8_t chars[HID_MAX_KEYS];
+    unsigned n;
+
+    switch (decode_state) {
+        // idle -- get next opcode
+        case D_IDLE:
+            if (script_pos >= script_len) {
+                if (decode_emit(report, 1))
+                    decode_state = D_DONE;
+                return;
+            }
+
+            if (repeating) {
+                if (repeat_counter == 0) {
+                    repeating = 0;
+                    script_pos += 3; // skip repeat opcode
+                } else {
+                    --repeat_counter;
+                    script_pos = repeat_pos; // jump back to prev op
+                }
+            }
+
+            opcode = payload_byte(script_pos++);
+            if (opcode != OP_REPEAT)
+                repeat_pos = script_pos-1;
+
+            switch (opcode) {
+                case OP_NOP:
+                    ++script_pos;
                     return;
 
-                // key down - lift key
-                case R_KEY_DOWN:
-                    // all keys up
-                    USBHwEPWrite(INTR_IN_EP, report, 8);
-                    timer0_set_match(NOW + DOWN_TIME);
-                    run_state = R_IDLE;
-                    // timer0_set_match(NOW + 1);
+                case OP_KEY:
+                    // TODO bounds check
+                    script_key.type = payload_byte(script_pos++);
+                    script_key.mod = payload_byte(script_pos++);
+                    script_key.chr = payload_byte(script_pos++);
+                    decode_state = D_KEY;
                     return;
 
-                case R_DELAY:
-                    run_state = R_IDLE;
-                    timer0_set_match(NOW + 1);
+                case OP_DELAY:
+                    // TODO bounds check
+                    pending_delay += payload_word(script_pos);
+                    script_pos += 2;
+                    return;
+
+                case OP_STRING:
+                    // TODO bounds check
+                    string_len = payload_word(script_pos);
+                    string_pos = 0;
+                    script_pos += 2;
+                    decode_state = D_STRING;
                     return;
 
-                // string - sub state machine
-                case R_STRING:
-                    switch (string_state) {
-                        // idle - get next key
-                        case S_IDLE:
-                            // end of string, next
-                            if (string_pos >= string_len) {
-                                script_pos += string_len;
-                                run_state = R_IDLE;
-                                timer0_set_match(NOW + 1);
-                                return;
-                            }
-
-                            next_key.type = K_CHAR;
-                            next_key.mod = 0;
-                            next_key.chr = script[script_pos + string_pos];
-                            ++string_pos;
-
-                            hid_encode(&next_key, report);
-                            USBHwEPWrite(INTR_IN_EP, report, 8);
-                            string_state = S_KEY_DOWN;
-                            timer0_set_match(NOW + DOWN_TIME);
-                            return;
-
-                        // key down - lift and go back to idle state
-                        case S_KEY_DOWN:
-                            USBHwEPWrite(INTR_IN_EP, report, 8);
-                            timer0_set_match(NOW + DOWN_TIME);
-                            string_state = S_IDLE;
-                            return;
+                case OP_REPEAT:
+                    repeating = 1;
+                    repeat_counter = payload_word(script_pos);
+                    return;
+
+                case OP_LOOP:
+                    n = payload_word(script_pos);
+                    script_pos += 4;
+                    if (n == 0) {
+                        script_pos += payload_word(script_pos - 2);
+                    } else if (loop_depth < LOOP_DEPTH) {
+                        loop_stack[loop_depth].body = script_pos;
+                        loop_stack[loop_depth].left = n;
+                        ++loop_depth;
+                    } else {
+                        // nested too deep, script_gen.py won't emit this
+                        script_pos = script_len;
                     }
                     return;
+
+                case OP_ENDLOOP:
+                    if (loop_depth == 0)
+                        return;
+                    if (--loop_stack[loop_depth - 1].left != 0)
+                        script_pos = loop_stack[loop_depth - 1].body;
+                    else
+                        --loop_depth;
+                    return;
+            }
+            return;
+
+        // key - encode and inject key
+        case D_KEY:
+            hid_encode(&script_key, report);
+            if (decode_emit(report, 0))
+                decode_state = D_KEY_UP;
+            return;
+
+        // key up - all keys up
+        case D_KEY_UP:
+            if (decode_emit(report, 0))
+                decode_state = D_IDLE;
+            return;
+
+        // string - pack as many chars as possible into each report
+        case D_STRING:
+            // end of string, release held keys and go to next op
+            if (string_pos >= string_len && string_report[2] == 0) {
+                script_pos += string_len;
+                decode_state = D_IDLE;
+                return;
+            }
+
+            // an empty report (all keys up) is encoded when the held
+            // keys must be released before the next char
+            for (n = 0; n < HID_MAX_KEYS && string_pos + n < string_len; ++n)
+                chars[n] = payload_byte(script_pos + string_pos + n);
+            n = hid_encode_string(chars, n, string_report, report);
+            if (decode_emit(report, 0)) {
+                string_pos += n;
+                memcpy(string_report, report, 8);
             }
+            return;
+    }
+}
+#endif
+
+// decode ahead until the ring is full, a bounded number of steps at a time
+// so that a long run of delays or repeats can't hold up the main loop
+// returns: the number of steps taken, 0 if there was nothing to do
+static unsigned script_decode(void) {
+    unsigned steps;
+
+    for (steps = 0; steps < DECODE_STEPS && decode_state != D_DONE &&
+            event_slot() != NULL; ++steps)
+        decode_step();
+
+    return steps;
+}
+
+// start running payload n, only while the script is idle
+static void script_start(unsigned n) {
+    payload_select(n);
+
+    event_reset();
+    script_len = payload_open();
+    script_pos = 0;
+    decode_state = D_IDLE;
+    pending_delay = 0;
+    repeating = 0;
+    loop_depth = 0;
+    memset(string_report, 0, 8);
+#ifdef REPORT_STREAM
+    memset(stream_report, 0, 8);
+#endif
+    script_decode();
+
+    delay_done = 0;
+#ifdef ADAPTIVE_RATE
+    rate_start();
+#endif
+    script_state = ST_RUNNING;
+
+    // first report in 1 ms
+    timer0_set_match(NOW + 1);
+}
+
+// Abort, pause and resume
+//
+// These come from the main loop with TIMER0 and USB masked, so the player
+// and the report queue stand still while they run. Each one that changes
+// anything puts an all keys up report ahead of the queue, which the host
+// reads after the report already in the endpoint, so no key is left held
+// and the script goes quiet within one report interval.
+
+// stop the script and drop whatever of it the host hasn't read
+static void script_abort(void) {
+    timer0_clear_match();
+    usb_flush_reports();
+    usb_hold_reports(0);
+    usb_keys_up();
+
+    if (script_state != ST_IDLE) {
+        event_reset();
+        script_state = ST_IDLE;
+        payload_close();
+    }
+}
+
+// hold the script where it is, the reports it has queued wait for resume
+static void script_pause(void) {
+    usb_keys_up();
+
+    if (script_state == ST_RUNNING) {
+        timer0_clear_match();
+        usb_hold_reports(1);
+        script_state = ST_PAUSED;
+    }
+}
+
+// carry on with a paused script, a delay it was in starts over
+static void script_resume(void) {
+    if (script_state != ST_PAUSED)
+        return;
+
+    usb_hold_reports(0);
+    delay_done = 0;
+#ifdef ADAPTIVE_RATE
+    rate_resume(NOW);
+#endif
+    script_state = ST_RUNNING;
+    timer0_set_match(NOW + 1);
+}
+
+// send the oldest event, reports are queued as fast as the host reads them
+// and an event that can't go yet is tried again in 1 ms
+static void script_play(void) {
+    script_event_t *ev = event_peek();
+#ifdef ADAPTIVE_RATE
+    uint8_t probe[8];
+#endif
+
+    // decoding has fallen behind
+    if (ev == NULL) {
+        timer0_set_match(NOW + 1);
+        return;
+    }
+
+    // delays start once the host has read every report before them, so
+    // a delay starts after the last key it follows
+    if (ev->delay != 0 && !delay_done) {
+        if (usb_reports_pending() == 0) {
+            delay_done = 1;
+            timer0_set_match(NOW + ev->delay);
+        } else {
+            timer0_set_match(NOW + 1);
         }
+        return;
+    }
+
+#ifdef ADAPTIVE_RATE
+    // probes of the host go in between the script's reports and set the
+    // time each report is held, see rate.c
+    if (!ev->end) {
+        switch (rate_probe(NOW, probe)) {
+            case RATE_SEND:
+                if (usb_queue_report(probe)) {
+                    rate_sent(NOW, probe);
+                    timer0_set_match(NOW + REPORT_HOLD);
+                } else {
+                    timer0_set_match(NOW + 1);
+                }
+                return;
+
+            case RATE_WAIT:
+                timer0_set_match(NOW + 1);
+                return;
+        }
+    }
+#endif
+
+    if (ev->end) {
+        event_pop();
+        script_state = ST_IDLE;
+        payload_close();
+        return;
+    }
+
+    if (usb_queue_report(ev->report)) {
+#ifdef ADAPTIVE_RATE
+        rate_sent(NOW, ev->report);
+#endif
+        event_pop();
+        delay_done = 0;
+        timer0_set_match(NOW + REPORT_HOLD);
+        return;
+    }
+    timer0_set_match(NOW + 1);
+}
+
+void TIMER0_IRQHandler(void) {
+    if (T0IR & TIR_MR0_Interrupt) {
+        // ack the interrupt
+        T0IR = TIR_MR0_Interrupt;
+
+        if (script_state == ST_RUNNING)
+            script_play();
     }
 
     // LEDs
@@ -265,55 +511,116 @@ void TIMER0_IRQHandler(void) {
         T0IR = TIR_MR1_Interrupt;
         RXLED_CLR;
     }
-}
 
-int magic_present(uint8_t *packet, uint8_t *magic) {
-    unsigned i;
-
-    for (i = 0; i < BLE_PACKET_SIZE - 16; ++i)
-        if (memcmp(packet + i, magic, 16) == 0)
-            return 1;
-
-    return 0;
+    // wake tick, returning from the interrupt is all it takes
+    if (T0IR & TIR_MR2_Interrupt) {
+        T0IR = TIR_MR2_Interrupt;
+        T0MR2 = NOW + 1;
+    }
 }
 
-// from usb.c
-void usb_init(void);
-
 int main() {
     uint8_t ble_packet[BLE_PACKET_SIZE];
+    ble_rx_info_t rx_info;
+    uint32_t loop_start, loop_end;
     int led_state = 0;
+    int trigger, payload, busy;
+    int aborting = 0;
+    uint32_t abort_start = 0;
     uint32_t led_next_event = LED_PERIOD - LED_ON_TIME;
 
     ubertooth_init();
 
+    irq_init();
     timer0_start();
 
     usb_init();
     ble_init();
+    trigger_init();
+    payload_init();
 
-    // call USB interrupt handler continuously
+    // USB is handled by its interrupt and BLE packets are received by
+    // interrupt and queued for the loop, which sleeps when it has nothing
+    // left to do until an interrupt or the 1 ms tick wakes it
+    loop_start = ble_now_us();
     while (1) {
-        USBHwISR();
+        // how long a trip round the loop takes bounds how late packets are
+        // handled, sleeping included
+        loop_end = ble_now_us();
+        if (loop_end - loop_start > loop_latency_max)
+            loop_latency_max = loop_end - loop_start;
+        loop_start = loop_end;
+
+        busy = 0;
+
+#ifdef SCRIPT_UPLOAD
+        // erase for an upload and program its pages as USB delivers them, a
+        // new upload must not restart the flash under us
+        ICER0 = ICER0_ICE_USB;
+        busy |= upload_poll();
+        ISER0 = ISER0_ISE_USB;
+#endif
+
+        // bring the radio up or back into RX if it is on its way
+        if (!ble_poll())
+            busy = 1;
 
         // fetch BLE packets
-        if (ble_get_packet(ble_packet)) {
+        if (ble_get_packet(ble_packet, &rx_info)) {
+            busy = 1;
+
+            // uploads replace the triggers and payloads from the USB
+            // interrupt, so keep it out while they are in use
+            ICER0 = ICER0_ICE_USB;
+
             // blink LED - TODO something more interesting
             RXLED_SET;
             T0MR1 = NOW + 10;
             T0MCR |= TMCR_MR1I;
 
+            trigger = trigger_check(ble_packet, &payload);
+            if (trigger != TRIGGER_NONE)
+                ble_count_trigger(&rx_info);
+#ifdef OTA_UPLOAD
+            else
+                ota_packet(ble_packet);
+#endif
+
             // launch script if magic string is in packet and we're idle
-            if (script_state == ST_IDLE && magic_present(ble_packet, ble_magic)) {
-                script_state = ST_READY;
-                timer0_set_match(NOW + 1);
+            if (trigger == TRIGGER_SCRIPT && script_state == ST_IDLE) {
+                script_start(payload);
+
+                trigger_latency = ble_now_us() - rx_info.time;
+                if (trigger_latency > trigger_latency_max)
+                    trigger_latency_max = trigger_latency;
+            }
+
+            // abort, pause and resume act on the script whatever state it
+            // is in, keep the player out while they do
+            else if (trigger == TRIGGER_ABORT || trigger == TRIGGER_PAUSE ||
+                    trigger == TRIGGER_RESUME) {
+                ICER0 = ICER0_ICE_TIMER0;
+
+                if (trigger == TRIGGER_ABORT) {
+                    // time the first abort of a script, not its repeats
+                    if (script_state != ST_IDLE && !aborting) {
+                        aborting = 1;
+                        abort_start = rx_info.time;
+                    }
+                    script_abort();
+                } else if (trigger == TRIGGER_PAUSE) {
+                    script_pause();
+                } else {
+                    script_resume();
+                }
+
+                ISER0 = ISER0_ISE_TIMER0;
             }
 
             // if the bootloader magic is present, reset to bootloader
-            else if (magic_present(ble_packet, bootloader_magic)) {
-                // turn off radio
-                cc2400_strobe(SRFOFF);
-                while ((cc2400_status() & FS_LOCK)); // need to wait for unlock?
+            else if (trigger == TRIGGER_BOOTLOADER) {
+                // turn off radio, the reset doesn't need to wait for it
+                ble_off();
 #ifdef UBERTOOTH_ONE
                 PAEN_CLR;
                 HGM_CLR;
@@ -323,8 +630,22 @@ int main() {
                 bootloader_ctrl = DFU_MODE;
                 reset();
             }
+
+            ISER0 = ISER0_ISE_USB;
         }
 
+        // an aborted script is silent once the host has read all keys up
+        if (aborting && usb_reports_pending() == 0) {
+            aborting = 0;
+            abort_latency = ble_now_us() - abort_start;
+            if (abort_latency > abort_latency_max)
+                abort_latency_max = abort_latency;
+        }
+
+        // keep the script decoded ahead of TIMER0_IRQHandler
+        if (script_state == ST_RUNNING && script_decode() != 0)
+            busy = 1;
+
         // blink LED
         if (NOW >= led_next_event) {
             if (led_state == 0) {
@@ -337,6 +658,12 @@ int main() {
                 led_next_event += LED_PERIOD - LED_ON_TIME;
             }
         }
+
+        // WFE rather than WFI: an interrupt taken since the checks above
+        // sets the event register and the WFE falls straight through, so a
+        // wakeup can't be lost between deciding to sleep and sleeping
+        if (!busy)
+            WFE();
     }
 
     return 0;
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#include "upload.h"
+#include "payload.h"
+#include "trigger.h"
+
+#include <string.h>
+
+// in-application programming, LPC17xx user manual chapter 32
+#define IAP_LOCATION    0x1fff1ff1
+#define IAP_PREPARE     50
+#define IAP_COPY_RAM    51
+#define IAP_ERASE       52
+#define IAP_SUCCESS     0
+#define CCLK_KHZ        100000
+
+typedef void (*iap_fn)(uint32_t *command, uint32_t *result);
+
+// header in the first page of the region, written once the image checks out
+#define UPLOAD_MAGIC    0x594b4455 // "UDKY"
+
+typedef struct _upload_header_t {
+    uint32_t magic;
+    uint32_t len;
+    uint32_t crc;
+} upload_header_t;
+
+#define HEADER  ((const upload_header_t *)UPLOAD_FLASH_BASE)
+#define IMAGE   ((const uint8_t *)UPLOAD_FLASH_BASE + UPLOAD_PAGE_SIZE)
+
+// two page buffers, so one fills from USB while the other waits for
+// upload_poll to program it
+static uint32_t page_buf[2][UPLOAD_PAGE_SIZE / 4];
+static volatile int page_ready[2] = { 0, };
+static unsigned fill = 0;           // buffer being filled
+static unsigned fill_len = 0;       // bytes in it
+static unsigned prog = 0;           // next buffer to program
+static uint32_t prog_addr = 0;      // where it goes
+
+static uint32_t image_len = 0;      // announced by upload_start
+static uint32_t received = 0;
+static int active = 0;              // between upload_start and upload_end
+static volatile unsigned erase_next = 0;    // sector upload_poll erases next, 0 for none
+static int failed = 0;              // a page failed to program
+
+static uint32_t iap(uint32_t cmd, uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3) {
+    uint32_t command[5] = { cmd, p0, p1, p2, p3 };
+    uint32_t result[5];
+
+    // flash can't be read while IAP runs, and the vector table is in flash
+    asm volatile ("cpsid i");
+    ((iap_fn)IAP_LOCATION)(command, result);
+    asm volatile ("cpsie i");
+
+    return result[0];
+}
+
+static int flash_erase(unsigned sector) {
+    return iap(IAP_PREPARE, sector, sector, 0, 0) == IAP_SUCCESS &&
+           iap(IAP_ERASE, sector, sector, CCLK_KHZ, 0) == IAP_SUCCESS;
+}
+
+static int flash_page(uint32_t addr, uint32_t *buf) {
+    return iap(IAP_PREPARE, UPLOAD_SECTOR_FIRST, UPLOAD_SECTOR_LAST, 0, 0) == IAP_SUCCESS &&
+           iap(IAP_COPY_RAM, addr, (uintptr_t)buf, UPLOAD_PAGE_SIZE, CCLK_KHZ) == IAP_SUCCESS;
+}
+
+// CRC-32 as used by zlib, so the host can compute it with zlib.crc32
+uint32_t upload_crc32(const uint8_t *p, unsigned len) {
+    uint32_t crc = 0xffffffff;
+    unsigned i;
+
+    while (len--) {
+        crc ^= *p++;
+        for (i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+// the uploaded image if there is a complete one, otherwise NULL
+const uint8_t *upload_image(void) {
+    if (HEADER->magic != UPLOAD_MAGIC || HEADER->len > UPLOAD_MAX_LEN ||
+            upload_crc32(IMAGE, HEADER->len) != HEADER->crc)
+        return NULL;
+    return IMAGE;
+}
+
+// begin a new image of len bytes. An erase keeps interrupts off for up to
+// 100 ms a sector, so it is left to upload_poll in the main loop rather
+// than done here in the USB interrupt.
+// returns: 1 on success, 0 if the image is too big or the uploaded image is
+// in use by a script
+int upload_start(uint32_t len) {
+    if (len == 0 || len > UPLOAD_MAX_LEN)
+        return 0;
+    if (payload_in_use() && upload_image() != NULL)
+        return 0;
+
+    active = 0;
+    image_len = len;
+    erase_next = UPLOAD_SECTOR_FIRST;
+
+    return 1;
+}
+
+// erase the next sector of the region, and once it is all erased get ready
+// for the image
+static void upload_erase(void) {
+    // a script may have started on the uploaded image since upload_start
+    if (erase_next == UPLOAD_SECTOR_FIRST && payload_in_use() && upload_image() != NULL) {
+        erase_next = 0;
+        return;
+    }
+
+    // back to the built in payloads until the new image is complete, the
+    // old image's header is still valid until its sector is erased
+    if (erase_next == UPLOAD_SECTOR_FIRST) {
+        trigger_init();
+        payload_init_builtin();
+    }
+
+    if (!flash_erase(erase_next)) {
+        erase_next = 0;
+        return;
+    }
+    if (erase_next++ != UPLOAD_SECTOR_LAST)
+        return;
+    erase_next = 0;
+
+    page_ready[0] = page_ready[1] = 0;
+    fill = fill_len = prog = 0;
+    prog_addr = UPLOAD_FLASH_BASE + UPLOAD_PAGE_SIZE;
+    received = 0;
+    failed = 0;
+    active = 1;
+}
+
+// take the next chunk of the image
+// returns: 1 on success, 0 if it is out of order, the region is still being
+// erased or both page buffers are waiting to be programmed, in which case
+// the host should retry, or the erase failed
+int upload_data(unsigned chunk, uint8_t *data, unsigned len) {
+    if (!active || failed || chunk * UPLOAD_CHUNK != received ||
+            received + len > image_len)
+        return 0;
+    // only the last chunk may be short, so chunks never straddle pages
+    if (len != UPLOAD_CHUNK && received + len != image_len)
+        return 0;
+    if (page_ready[fill])
+        return 0;
+
+    memcpy((uint8_t *)page_buf[fill] + fill_len, data, len);
+    fill_len += len;
+    received += len;
+
+    if (fill_len == UPLOAD_PAGE_SIZE) {
+        page_ready[fill] = 1;
+        fill ^= 1;
+        fill_len = 0;
+    }
+
+    return 1;
+}
+
+// erase for a new image or program a full page buffer, called from the main
+// loop so that it is not done while USB waits
+// returns: 1 if it erased or programmed, 0 if there was nothing to do
+int upload_poll(void) {
+    if (erase_next != 0) {
+        upload_erase();
+        return 1;
+    }
+    if (!page_ready[prog])
+        return 0;
+
+    if (!flash_page(prog_addr, page_buf[prog]))
+        failed = 1;
+    page_ready[prog] = 0;
+    prog ^= 1;
+    prog_addr += UPLOAD_PAGE_SIZE;
+    return 1;
+}
+
+// program what is left, check the image and commit it by writing its header
+// returns: 1 on success
+static int upload_commit(uint32_t crc) {
+    upload_header_t *header = (upload_header_t *)page_buf[0];
+
+    if (received != image_len)
+        return 0;
+
+    // pad the last page with erased flash
+    if (fill_len != 0) {
+        memset((uint8_t *)page_buf[fill] + fill_len, 0xff, UPLOAD_PAGE_SIZE - fill_len);
+        page_ready[fill] = 1;
+    }
+    while (page_ready[prog])
+        upload_poll();
+
+    if (failed || upload_crc32(IMAGE, image_len) != crc)
+        return 0;
+
+    memset(page_buf[0], 0xff, UPLOAD_PAGE_SIZE);
+    header->magic = UPLOAD_MAGIC;
+    header->len = image_len;
+    header->crc = crc;
+    return flash_page(UPLOAD_FLASH_BASE, page_buf[0]);
+}
+
+// finish an upload
+// returns: 1 if the new image is in use, 0 if it was incomplete or corrupt,
+// in which case the built in payloads are
+int upload_end(uint32_t crc) {
+    int ok;
+
+    if (!active)
+        return 0;
+    active = 0;
+
+    // the new image, or the built in payloads if it failed since then its
+    // header was never written or fails its CRC
+    ok = upload_commit(crc);
+    trigger_init();
+    payload_init();
+
+    return ok;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __UPLOAD_H__
+#define __UPLOAD_H__
+
+#include <stdint.h>
+
+// vendor requests, device recipient, see ducky_upload.py
+#define UPLOAD_REQ_START    0x10    // wIndex:wValue image length, erase follows
+#define UPLOAD_REQ_DATA     0x11    // OUT, wValue chunk number
+#define UPLOAD_REQ_END      0x12    // wIndex:wValue CRC-32 of the image
+
+// bytes per UPLOAD_REQ_DATA, the last may be shorter
+#define UPLOAD_CHUNK        64
+
+// flash set aside for an uploaded image, the last two 4 kB sectors of the
+// LPC1752, the firmware must end below UPLOAD_FLASH_BASE
+#define UPLOAD_FLASH_BASE   0xe000
+#define UPLOAD_FLASH_SIZE   0x2000
+#define UPLOAD_SECTOR_FIRST 14
+#define UPLOAD_SECTOR_LAST  15
+
+// the image is programmed a page at a time, the first page holds a header
+// that is written last
+#define UPLOAD_PAGE_SIZE    256
+#define UPLOAD_MAX_LEN      (UPLOAD_FLASH_SIZE - UPLOAD_PAGE_SIZE)
+
+const uint8_t *upload_image(void);
+int upload_start(uint32_t len);
+int upload_data(unsigned chunk, uint8_t *data, unsigned len);
+int upload_end(uint32_t crc);
+int upload_poll(void);
+uint32_t upload_crc32(const uint8_t *p, unsigned len);
+
+#endif /* __UPLOAD_H__ */
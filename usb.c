@@ -29,15 +29,31 @@
 #include "usbhw_lpc.h"
 #include "ubertooth.h"
 
-#define LE_WORD(x)      ((x)&0xFF),((x)>>8)
+#include "hid.h"
+#include "usb.h"
+#include "report_queue.h"
+#include "stats.h"
+#ifdef SCRIPT_UPLOAD
+#include "upload.h"
+#endif
 
-#define REPORT_SIZE         8
+#define LE_WORD(x)      ((x)&0xFF),((x)>>8)
 
 #define INTR_IN_EP      0x81
 
 static U8   abClassReqData[4];
+#ifdef SCRIPT_UPLOAD
+// the data stage of UPLOAD_REQ_DATA lands here
+static U8   abVendorReqData[UPLOAD_CHUNK];
+#else
+static U8   abVendorReqData[4];
+#endif
+static uint32_t stats_buf[STATS_WORDS];
 static int  _iIdleRate = 0;
 
+// keyboard LEDs as last set by the host
+volatile uint8_t usb_leds = 0;
+
 // Report descriptor from Apple Aluminum Keyboard MB110LL/A
 static U8 abReportDesc[] = {
     0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
@@ -133,7 +149,7 @@ static U8 abDescriptors[] = {
     INTR_IN_EP,             // bEndpointAddress
     0x03,                   // bmAttributes = INT - interrupt
     LE_WORD(MAX_PACKET_SIZE0),// wMaxPacketSize
-    10,                     // bInterval
+    DOWN_TIME,              // bInterval
 
     // string descriptors
     0x04,
@@ -225,12 +241,95 @@ static BOOL HandleClassRequest(TSetupPacket *pSetup, int *piLen, U8 **ppbData)
         _iIdleRate = ((pSetup->wValue >> 8) & 0xFF) * 4;
         break;
 
+    // set_report: the only output report is the LEDs
+    case HID_SET_REPORT:
+        if (*piLen < 1)
+            return FALSE;
+        usb_leds = pbData[0];
+        *piLen = 0;
+        break;
+
     default:
         return FALSE;
     }
     return TRUE;
 }
 
+/*************************************************************************
+    HandleVendorRequest
+    ===================
+        Statistics requests, see stats.h, and with SCRIPT_UPLOAD
+        payload upload requests, see upload.h. Stalling an upload
+        request tells the host it failed.
+
+**************************************************************************/
+static BOOL HandleVendorRequest(TSetupPacket *pSetup, int *piLen, U8 **ppbData)
+{
+    switch (pSetup->bRequest) {
+
+    case STATS_REQ_GET:
+        stats_snapshot(stats_buf);
+        *ppbData = (U8 *)stats_buf;
+        *piLen = sizeof(stats_buf);
+        break;
+
+    case STATS_REQ_RESET:
+        stats_reset();
+        *piLen = 0;
+        break;
+
+#ifdef SCRIPT_UPLOAD
+    case UPLOAD_REQ_START:
+        if (!upload_start(pSetup->wValue | ((uint32_t)pSetup->wIndex << 16)))
+            return FALSE;
+        *piLen = 0;
+        break;
+
+    case UPLOAD_REQ_DATA:
+        if (!upload_data(pSetup->wValue, *ppbData, *piLen))
+            return FALSE;
+        *piLen = 0;
+        break;
+
+    case UPLOAD_REQ_END:
+        if (!upload_end(pSetup->wValue | ((uint32_t)pSetup->wIndex << 16)))
+            return FALSE;
+        *piLen = 0;
+        break;
+#endif
+
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*************************************************************************
+    Report queue
+    ============
+        The queue itself is in report_queue.c, shared with the host trace.
+        This is its endpoint: reports are written to INTR_IN_EP, and the
+        queue is told when the host has read one and, with HIGH_RATE, of
+        every start-of-frame.
+
+**************************************************************************/
+
+void report_queue_write(const uint8_t *report) {
+    USBHwEPWrite(INTR_IN_EP, (U8 *)report, REPORT_SIZE);
+}
+
+// host has read the last report
+static void HIDHandleIntrIn(U8 bEP, U8 bEPStatus) {
+    report_queue_in();
+}
+
+#ifdef HIGH_RATE
+// start of frame
+static void HIDHandleFrame(U16 wFrame) {
+    report_queue_frame();
+}
+#endif
+
 static void set_serial_descriptor(U8 *descriptors) {
     U8 buf[17], *desc, nibble;
     int len, i;
@@ -263,9 +362,22 @@ void usb_init(void) {
     // register class request handler
     USBRegisterRequestHandler(REQTYPE_TYPE_CLASS, HandleClassRequest, abClassReqData);
 
+    // register vendor request handler
+    USBRegisterRequestHandler(REQTYPE_TYPE_VENDOR, HandleVendorRequest, abVendorReqData);
+
     // register endpoint
-    USBHwRegisterEPIntHandler(INTR_IN_EP, NULL);
+    USBHwRegisterEPIntHandler(INTR_IN_EP, HIDHandleIntrIn);
+#ifdef HIGH_RATE
+    USBHwRegisterFrameHandler(HIDHandleFrame);
+#endif
 
     // connect to bus
     USBHwConnect(TRUE);
+
+    // from here on the stack runs from USB_IRQHandler
+    ISER0 = ISER0_ISE_USB;
+}
+
+void USB_IRQHandler(void) {
+    USBHwISR();
 }
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2019 Mike Ryan
+ *
+ * This file is part of Uberducky and is released under the terms of the
+ * GPL version 2. Refer to COPYING for more information.
+ */
+
+#ifndef __USB_H__
+#define __USB_H__
+
+#include <stdint.h>
+
+// number of reports that can wait for the host, must be a power of 2
+#define REPORT_QUEUE_LEN 16
+
+// number of times the queue filled up and the player had to wait for the
+// host, reports are never dropped
+extern volatile uint32_t report_queue_full;
+
+// keyboard LEDs as last set by the host, bit 0 is Num Lock, 1 Caps Lock
+extern volatile uint8_t usb_leds;
+
+void usb_init(void);
+int usb_queue_report(uint8_t *report);
+unsigned usb_reports_pending(void);
+void usb_keys_up(void);
+void usb_flush_reports(void);
+void usb_hold_reports(int hold);
+
+#endif /* __USB_H__ */
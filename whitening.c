@@ -0,0 +1,17 @@
+// generated by whitening_gen.py
+#include <stdint.h>
+// dewhitening words for channels 37, 38, 39
+const uint32_t ble_whitening[3][8] = {
+    { // channel 37
+        0xa157d28d, 0xb066a73d, 0x48113175, 0xe3f87796,
+        0xd0abe946, 0xd833539e, 0x240898ba, 0x71fc3bcb,
+    },
+    { // channel 38
+        0x2044c5d6, 0x8fe1de59, 0x42afa51b, 0x60cd4e7b,
+        0x902262eb, 0xc7f0ef2c, 0xa157d28d, 0xb066a73d,
+    },
+    { // channel 39
+        0x5f4a371f, 0x9a9cf685, 0x44c5d6c1, 0xe1de5920,
+        0xafa51b8f, 0xcd4e7b42, 0x2262eb60, 0xf0ef2c90,
+    },
+};
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+
+# Copyright 2019 Mike Ryan
+#
+# This file is part of Uberducky and is released under the terms of the
+# GPL version 2. Refer to COPYING for more information.
+
+# BLE dewhitening tables. Outputs as C to stdout one table per advertising
+# channel, used by ble.c to dewhiten a packet a word at a time. The packet
+# size must match BLE_PACKET_SIZE in ble.h.
+
+from __future__ import print_function
+
+import sys
+
+PACKET_SIZE = 32
+
+# channels 37, 38 and 39, in the order ble.c hops through them
+CHANNELS = [37, 38, 39]
+
+def reverse8(b):
+    return int('{:08b}'.format(b)[::-1], 2)
+
+# whitening sequence of a channel, x^7 + x^4 + 1 seeded with the channel
+# index (Core spec Vol 6 Part B 3.2). Bit n of each byte whitens the nth bit
+# on air, which ble_dewhiten has reversed into bit n.
+def whitening(channel, length):
+    lfsr = reverse8(channel) | 2
+    out = []
+    for i in range(length):
+        b = 0
+        for bit in range(8):
+            if lfsr & 0x80:
+                lfsr ^= 0x11
+                b |= 1 << bit
+            lfsr = (lfsr << 1) & 0xff
+        out.append(b)
+    return out
+
+# little endian words, as ble_dewhiten stores them
+def to_words(stream):
+    return [stream[i] | stream[i+1] << 8 | stream[i+2] << 16 | stream[i+3] << 24
+            for i in range(0, len(stream), 4)]
+
+def whitening_to_c():
+    print('// generated by whitening_gen.py')
+    print('#include <stdint.h>')
+    print('// dewhitening words for channels %s' % ', '.join(map(str, CHANNELS)))
+    print('const uint32_t ble_whitening[%d][%d] = {' % (len(CHANNELS), PACKET_SIZE // 4))
+    for channel in CHANNELS:
+        words = to_words(whitening(channel, PACKET_SIZE))
+        print('    { // channel %d' % channel)
+        for i in range(0, len(words), 4):
+            print('        %s,' % ', '.join('0x%08x' % w for w in words[i:i+4]))
+        print('    },')
+    print('};')
+
+if __name__ == "__main__":
+    whitening_to_c()